@@ -0,0 +1,303 @@
+#include "AabbTree.h"
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+
+static Aabb bubbleBounds(glm::vec2 center, float extent) {
+    return { center - glm::vec2(extent), center + glm::vec2(extent) };
+}
+
+AabbTree::AabbTree()
+    : root(-1), free_list(-1), step_stamp(0), last_reinsert_count(0) {
+}
+
+int AabbTree::allocateNode() {
+    int index;
+    if (free_list >= 0) {
+        index = free_list;
+        free_list = nodes[index].next_free;
+    }
+    else {
+        index = static_cast<int>(nodes.size());
+        nodes.push_back(Node());
+    }
+    Node& node = nodes[index];
+    node.parent = -1;
+    node.child1 = -1;
+    node.child2 = -1;
+    node.height = 0;
+    node.next_free = -1;
+    node.bubble_id = -1;
+    node.bubble = -1;
+    return index;
+}
+
+void AabbTree::freeNode(int node) {
+    nodes[node].next_free = free_list;
+    nodes[node].height = -1;
+    free_list = node;
+}
+
+void AabbTree::insertLeaf(int leaf) {
+    if (root < 0) {
+        root = leaf;
+        nodes[root].parent = -1;
+        return;
+    }
+
+    // Walk down to the cheapest sibling (surface area heuristic on perimeters)
+    const Aabb leaf_box = nodes[leaf].box;
+    int index = root;
+    while (!nodes[index].isLeaf()) {
+        const Node& node = nodes[index];
+        const float area = node.box.getPerimeter();
+        const float combined_area = Aabb::combine(node.box, leaf_box).getPerimeter();
+
+        // Cost of making a new parent for this node and the leaf
+        const float cost = 2.0f * combined_area;
+        // Minimum cost of pushing the leaf further down the tree
+        const float inheritance_cost = 2.0f * (combined_area - area);
+
+        float child_costs[2];
+        const int children[2] = { node.child1, node.child2 };
+        for (int c = 0; c < 2; ++c) {
+            const Node& child = nodes[children[c]];
+            const float new_area = Aabb::combine(leaf_box, child.box).getPerimeter();
+            child_costs[c] = (child.isLeaf() ? new_area : new_area - child.box.getPerimeter()) + inheritance_cost;
+        }
+
+        if (cost < child_costs[0] && cost < child_costs[1]) break;
+        index = child_costs[0] < child_costs[1] ? children[0] : children[1];
+    }
+
+    const int sibling = index;
+    const int old_parent = nodes[sibling].parent;
+    const int new_parent = allocateNode();
+    nodes[new_parent].parent = old_parent;
+    nodes[new_parent].box = Aabb::combine(leaf_box, nodes[sibling].box);
+    nodes[new_parent].height = nodes[sibling].height + 1;
+
+    if (old_parent >= 0) {
+        if (nodes[old_parent].child1 == sibling) nodes[old_parent].child1 = new_parent;
+        else nodes[old_parent].child2 = new_parent;
+    }
+    else {
+        root = new_parent;
+    }
+    nodes[new_parent].child1 = sibling;
+    nodes[new_parent].child2 = leaf;
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    refitAncestors(nodes[leaf].parent);
+}
+
+void AabbTree::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = -1;
+        return;
+    }
+
+    const int parent = nodes[leaf].parent;
+    const int grand_parent = nodes[parent].parent;
+    const int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grand_parent >= 0) {
+        // Sibling takes the parent's place
+        if (nodes[grand_parent].child1 == parent) nodes[grand_parent].child1 = sibling;
+        else nodes[grand_parent].child2 = sibling;
+        nodes[sibling].parent = grand_parent;
+        freeNode(parent);
+        refitAncestors(grand_parent);
+    }
+    else {
+        root = sibling;
+        nodes[sibling].parent = -1;
+        freeNode(parent);
+    }
+}
+
+void AabbTree::refitAncestors(int node) {
+    int index = node;
+    while (index >= 0) {
+        index = balance(index);
+        const int child1 = nodes[index].child1;
+        const int child2 = nodes[index].child2;
+        nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+        nodes[index].box = Aabb::combine(nodes[child1].box, nodes[child2].box);
+        index = nodes[index].parent;
+    }
+}
+
+// Rotates the taller grandchild up if the subtree under a is unbalanced.
+// Returns the index of the new subtree root.
+int AabbTree::balance(int a) {
+    if (nodes[a].isLeaf() || nodes[a].height < 2) return a;
+
+    const int b = nodes[a].child1;
+    const int c = nodes[a].child2;
+    const int height_difference = nodes[c].height - nodes[b].height;
+
+    // Rotate c up
+    if (height_difference > 1) {
+        const int f = nodes[c].child1;
+        const int g = nodes[c].child2;
+
+        nodes[c].child1 = a;
+        nodes[c].parent = nodes[a].parent;
+        nodes[a].parent = c;
+
+        if (nodes[c].parent >= 0) {
+            if (nodes[nodes[c].parent].child1 == a) nodes[nodes[c].parent].child1 = c;
+            else nodes[nodes[c].parent].child2 = c;
+        }
+        else {
+            root = c;
+        }
+
+        // Keep the taller of f and g under c
+        const int keep = nodes[f].height > nodes[g].height ? f : g;
+        const int move = keep == f ? g : f;
+        nodes[c].child2 = keep;
+        nodes[a].child2 = move;
+        nodes[move].parent = a;
+        nodes[a].box = Aabb::combine(nodes[b].box, nodes[move].box);
+        nodes[c].box = Aabb::combine(nodes[a].box, nodes[keep].box);
+        nodes[a].height = 1 + std::max(nodes[b].height, nodes[move].height);
+        nodes[c].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+        return c;
+    }
+
+    // Rotate b up
+    if (height_difference < -1) {
+        const int d = nodes[b].child1;
+        const int e = nodes[b].child2;
+
+        nodes[b].child1 = a;
+        nodes[b].parent = nodes[a].parent;
+        nodes[a].parent = b;
+
+        if (nodes[b].parent >= 0) {
+            if (nodes[nodes[b].parent].child1 == a) nodes[nodes[b].parent].child1 = b;
+            else nodes[nodes[b].parent].child2 = b;
+        }
+        else {
+            root = b;
+        }
+
+        // Keep the taller of d and e under b
+        const int keep = nodes[d].height > nodes[e].height ? d : e;
+        const int move = keep == d ? e : d;
+        nodes[b].child2 = keep;
+        nodes[a].child1 = move;
+        nodes[move].parent = a;
+        nodes[a].box = Aabb::combine(nodes[c].box, nodes[move].box);
+        nodes[b].box = Aabb::combine(nodes[a].box, nodes[keep].box);
+        nodes[a].height = 1 + std::max(nodes[c].height, nodes[move].height);
+        nodes[b].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+        return b;
+    }
+
+    return a;
+}
+
+void AabbTree::syncLeaves(const BubbleStore& bubbles) {
+    step_stamp++;
+    last_reinsert_count = 0;
+    leaf_of_bubble.assign(bubbles.size(), -1);
+
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        ConstBubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal) continue;
+
+        const Aabb tight_box = bubbleBounds(bubble.position, bubble.radius + BROADPHASE_MARGIN);
+        const Aabb fat_box = bubbleBounds(bubble.position, bubble.radius + BROADPHASE_MARGIN + AABB_TREE_FAT_MARGIN);
+
+        const BubbleHandle handle = bubbles.getHandle(i);
+        if (handle.slot >= leaf_of_handle.size()) leaf_of_handle.resize(handle.slot + 1, -1);
+
+        // A reused store slot holds a different bubble, its old leaf is dropped below
+        int leaf = leaf_of_handle[handle.slot];
+        if (leaf < 0 || nodes[leaf].handle != handle) {
+            leaf = allocateNode();
+            nodes[leaf].box = fat_box;
+            nodes[leaf].bubble_id = bubble.id;
+            nodes[leaf].handle = handle;
+            insertLeaf(leaf);
+            leaf_of_handle[handle.slot] = leaf;
+            leaves.push_back(leaf);
+        }
+        else {
+            // Lazy refit: only moved or grown out of the fat box needs a reinsert
+            if (!nodes[leaf].box.contains(tight_box)) {
+                removeLeaf(leaf);
+                nodes[leaf].box = fat_box;
+                insertLeaf(leaf);
+                last_reinsert_count++;
+            }
+        }
+
+        nodes[leaf].bubble = static_cast<int>(i);
+        nodes[leaf].center = bubble.position;
+        nodes[leaf].radius = bubble.radius;
+        nodes[leaf].last_seen = step_stamp;
+        leaf_of_bubble[i] = leaf;
+    }
+
+    // Drop leaves whose bubbles are gone
+    size_t kept = 0;
+    for (size_t k = 0; k < leaves.size(); ++k) {
+        const int leaf = leaves[k];
+        if (nodes[leaf].last_seen != step_stamp) {
+            const uint32_t slot = nodes[leaf].handle.slot;
+            if (leaf_of_handle[slot] == leaf) leaf_of_handle[slot] = -1;
+            removeLeaf(leaf);
+            freeNode(leaf);
+            continue;
+        }
+        leaves[kept++] = leaf;
+    }
+    leaves.resize(kept);
+}
+
+void AabbTree::findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) {
+    syncLeaves(bubbles);
+    pairs.clear();
+
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        if (leaf_of_bubble[i] < 0) continue;
+        const int index = static_cast<int>(i);
+        const Aabb tight_box = bubbleBounds(bubbles[i].position, bubbles[i].radius + BROADPHASE_MARGIN);
+
+        query(tight_box, [&](int leaf) {
+            const int other = nodes[leaf].bubble;
+            if (other <= index) return; // Each pair is reported from its lower index only
+            const Aabb other_box = bubbleBounds(bubbles[other].position, bubbles[other].radius + BROADPHASE_MARGIN);
+            if (tight_box.overlaps(other_box)) {
+                pairs.push_back({ index, other });
+            }
+        });
+    }
+
+    sortPairs(pairs, static_cast<int>(bubbles.size()));
+}
+
+void AabbTree::queryPoint(glm::vec2 point, std::vector<int>& bubbleIds) const {
+    bubbleIds.clear();
+    query(Aabb{ point, point }, [&](int leaf) {
+        const Node& node = nodes[leaf];
+        if (glm::length2(point - node.center) <= node.radius * node.radius) {
+            bubbleIds.push_back(node.bubble_id);
+        }
+    });
+}
+
+void AabbTree::queryRadius(glm::vec2 center, float radius, std::vector<int>& bubbleIds) const {
+    bubbleIds.clear();
+    query(bubbleBounds(center, radius), [&](int leaf) {
+        const Node& node = nodes[leaf];
+        const float reach = radius + node.radius;
+        if (glm::length2(center - node.center) <= reach * reach) {
+            bubbleIds.push_back(node.bubble_id);
+        }
+    });
+}
@@ -0,0 +1,119 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BubbleStore.h"
+#include "Broadphase.h"
+
+// Axis aligned bounding box
+struct Aabb {
+    glm::vec2 min;
+    glm::vec2 max;
+
+    bool overlaps(const Aabb& other) const {
+        return min.x < other.max.x && other.min.x < max.x &&
+            min.y < other.max.y && other.min.y < max.y;
+    }
+
+    bool contains(const Aabb& other) const {
+        return min.x <= other.min.x && min.y <= other.min.y &&
+            other.max.x <= max.x && other.max.y <= max.y;
+    }
+
+    bool contains(glm::vec2 point) const {
+        return min.x <= point.x && min.y <= point.y && point.x <= max.x && point.y <= max.y;
+    }
+
+    float getPerimeter() const {
+        return 2.0f * ((max.x - min.x) + (max.y - min.y));
+    }
+
+    static Aabb combine(const Aabb& a, const Aabb& b) {
+        return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    }
+};
+
+// Dynamic bounding volume tree keyed by Bubble::id.
+// Leaves store fattened boxes and are only reinserted once a bubble moves or grows out of
+// its fat box, so slow risers and growing bubbles on a surface rarely touch the tree.
+// Internal nodes are kept balanced with AVL style rotations.
+class AabbTree : public Broadphase {
+public:
+    AabbTree();
+
+    void findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) override;
+
+    // Spatial queries for external tools, answered from the state of the last findPairs call.
+    // Both write the Bubble::id of every hit.
+    void queryPoint(glm::vec2 point, std::vector<int>& bubbleIds) const;
+    void queryRadius(glm::vec2 center, float radius, std::vector<int>& bubbleIds) const;
+
+    // Leaves reinserted by the last findPairs call (bubbles that left their fat box)
+    size_t getLastReinsertCount() const { return last_reinsert_count; }
+    int getHeight() const { return root < 0 ? 0 : nodes[root].height; }
+
+private:
+    struct Node {
+        Aabb box;        // Fat box for leaves, union of the children otherwise
+        int parent;
+        int child1;      // -1 for leaves
+        int child2;
+        int height;      // 0 for leaves
+        int next_free;
+
+        // Leaf data
+        int bubble_id;
+        BubbleHandle handle;
+        int bubble;      // Index into the bubble list for the current step
+        glm::vec2 center;
+        float radius;
+        int last_seen;
+
+        bool isLeaf() const { return child1 < 0; }
+    };
+
+    std::vector<Node> nodes;
+    int root;
+    int free_list;
+    std::vector<int> leaf_of_handle;         // BubbleHandle::slot -> leaf node, -1 if none
+    std::vector<int> leaves;                 // Every live leaf
+    std::vector<int> leaf_of_bubble;         // Bubble index -> leaf node, -1 if the bubble is skipped
+    mutable std::vector<int> query_stack;
+
+    int step_stamp;
+    size_t last_reinsert_count;
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void refitAncestors(int node);
+
+    // Updates leaves for the current bubbles, adds new ones and drops removed ones
+    void syncLeaves(const BubbleStore& bubbles);
+
+    // Calls visit(leaf) for every leaf whose fat box overlaps box
+    template <typename Visitor>
+    void query(const Aabb& box, Visitor visit) const {
+        if (root < 0) return;
+        query_stack.clear();
+        query_stack.push_back(root);
+        while (!query_stack.empty()) {
+            const int index = query_stack.back();
+            query_stack.pop_back();
+            const Node& node = nodes[index];
+            if (!node.box.overlaps(box)) continue;
+            if (node.isLeaf()) {
+                visit(index);
+            }
+            else {
+                query_stack.push_back(node.child1);
+                query_stack.push_back(node.child2);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Counts calls to the global operator new, every form of which allocationcounter.cpp replaces.
+// Only the BubbleTests target builds it, the application keeps the standard allocator.
+// Take the difference of two readings around a piece of code to see whether it allocated.
+size_t getAllocationCount();
+
+#endif
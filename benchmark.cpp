@@ -0,0 +1,725 @@
+#include "Benchmark.h"
+#include "AllocationCounter.h"
+#include "BodyForces.h"
+#include "BubbleGenerator.h"
+#include "BubbleStore.h"
+#include "Broadphase.h"
+#include "VerletList.h"
+#include "BubbleSimulator.h"
+#include "FluidGrid2D.h"
+#include "Narrowphase.h"
+#include "PoissonSolver.h"
+#include "SimulationClock.h"
+#include "SpatialHash.h"
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+struct BenchmarkScene {
+    const char* name;
+    int bubble_count;
+    float width;
+    float height;
+};
+
+const int BENCHMARK_STEPS = 60;
+const float BENCHMARK_DT = 1.0f / 60.0f;
+
+static BubbleStore makeScene(const BenchmarkScene& scene, unsigned int seed) {
+    std::mt19937 engine(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    BubbleStore bubbles;
+    bubbles.reserve(scene.bubble_count);
+    for (int i = 0; i < scene.bubble_count; ++i) {
+        float radius = BUBBLE_MIN_RADIUS + unit(engine) * (BUBBLE_MAX_RADIUS - BUBBLE_MIN_RADIUS) * 0.5f;
+        glm::vec2 position(unit(engine) * scene.width, unit(engine) * scene.height);
+        glm::vec2 velocity((unit(engine) - 0.5f) * 10.0f, 20.0f + unit(engine) * 40.0f);
+        bubbles.push_back(Bubble(i, position, radius, velocity));
+    }
+    return bubbles;
+}
+
+// Rising bubbles that wrap back to the bottom, close to what the simulator produces
+static void advanceScene(BubbleStore& bubbles, const BenchmarkScene& scene) {
+    glm::vec2* positions = bubbles.getPositions();
+    const glm::vec2* velocities = bubbles.getVelocities();
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        positions[i] += velocities[i] * BENCHMARK_DT;
+        if (positions[i].y > scene.height) positions[i].y -= scene.height;
+    }
+}
+
+static size_t countContacts(const BubbleStore& bubbles, const std::vector<BubblePair>& pairs) {
+    size_t contacts = 0;
+    for (const BubblePair& pair : pairs) {
+        float sum_radii = bubbles[pair.a].radius + bubbles[pair.b].radius;
+        if (glm::length2(bubbles[pair.b].position - bubbles[pair.a].position) < sum_radii * sum_radii) {
+            contacts++;
+        }
+    }
+    return contacts;
+}
+
+static void benchmarkBroadphases() {
+    const BenchmarkScene scenes[] = {
+        { "Sparse tank", 1000, 4000.0f, 4000.0f },
+        { "Dense foam", 4000, 1600.0f, 1200.0f },
+        { "Tall glass", 8000, 800.0f, 12000.0f },
+    };
+    const BroadphaseMode modes[] = {
+        BroadphaseMode::BruteForce,
+        BroadphaseMode::SpatialHash,
+        BroadphaseMode::SortAndSweep,
+        BroadphaseMode::AabbTree,
+        BroadphaseMode::VerletList,
+    };
+
+    printf("--- Broadphase (%d steps per scene) ---\n", BENCHMARK_STEPS);
+    printf("%-14s %-16s %10s %10s %10s\n", "Scene", "Broadphase", "ms/step", "pairs", "contacts");
+
+    for (const BenchmarkScene& scene : scenes) {
+        for (BroadphaseMode mode : modes) {
+            // Same seed for every mode, so they all see the same bubbles
+            BubbleStore bubbles = makeScene(scene, 1234u);
+            std::unique_ptr<Broadphase> broadphase = createBroadphase(mode, scene.width, scene.height);
+            std::vector<BubblePair> pairs;
+
+            double total_ms = 0.0;
+            size_t total_pairs = 0;
+            size_t total_contacts = 0;
+            for (int step = 0; step < BENCHMARK_STEPS; ++step) {
+                advanceScene(bubbles, scene);
+
+                auto start = std::chrono::steady_clock::now();
+                broadphase->findPairs(bubbles, pairs);
+                total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                total_pairs += pairs.size();
+                total_contacts += countContacts(bubbles, pairs);
+            }
+
+            printf("%-14s %-16s %10.3f %10zu %10zu\n", scene.name, getBroadphaseName(mode),
+                total_ms / BENCHMARK_STEPS, total_pairs / BENCHMARK_STEPS, total_contacts / BENCHMARK_STEPS);
+
+            if (const VerletList* verlet = dynamic_cast<const VerletList*>(broadphase.get())) {
+                const VerletListStats& stats = verlet->getStats();
+                printf("%-14s   rebuilds %.0f%% of steps, %.1f neighbours per bubble (max %d)\n", "",
+                    stats.getRebuildRate() * 100.0f, stats.average_list_size, stats.max_list_size);
+            }
+        }
+    }
+}
+
+// Full simulator steps inside a round glass outline made of segment_count segments
+static void runSurfaceScene(int segmentCount, SurfaceQueryMode mode, const char* modeName) {
+    const BenchmarkScene scene = { "Round glass", 2000, 1200.0f, 1200.0f };
+
+    auto setup_start = std::chrono::steady_clock::now();
+    BubbleSimulator simulator(static_cast<int>(scene.width), static_cast<int>(scene.height));
+    simulator.setSurfaceQueryMode(mode);
+    simulator.setSeed(1234u);
+    const glm::vec2 center(scene.width * 0.5f, scene.height * 0.5f);
+    const float glass_radius = scene.width * 0.45f;
+    for (int s = 0; s < segmentCount; ++s) {
+        // Counter-clockwise, so the left-hand normal points into the glass
+        float angle0 = 2.0f * glm::pi<float>() * s / segmentCount;
+        float angle1 = 2.0f * glm::pi<float>() * (s + 1) / segmentCount;
+        glm::vec2 start = center + glass_radius * glm::vec2(glm::cos(angle0), glm::sin(angle0));
+        glm::vec2 end = center + glass_radius * glm::vec2(glm::cos(angle1), glm::sin(angle1));
+        simulator.addSurface(Surface2D(s, start, end));
+    }
+    double setup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setup_start).count();
+
+    BubbleStore bubbles = makeScene(scene, 1234u);
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < BENCHMARK_STEPS; ++step) {
+        simulator.update(BENCHMARK_DT, bubbles);
+    }
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%-10d %-16s %10.3f %10.3f\n", segmentCount, modeName, setup_ms, total_ms / BENCHMARK_STEPS);
+}
+
+static void benchmarkSurfaces() {
+    const int segment_counts[] = { 16, 128, 1024 };
+
+    printf("--- Surfaces (%d steps, 2000 bubbles) ---\n", BENCHMARK_STEPS);
+    printf("%-10s %-16s %10s %10s\n", "Segments", "Query", "setup ms", "ms/step");
+    for (int segment_count : segment_counts) {
+        runSurfaceScene(segment_count, SurfaceQueryMode::Segments, "Segments");
+        runSurfaceScene(segment_count, SurfaceQueryMode::DistanceField, "Distance field");
+    }
+}
+
+// Relative to the reference value, absolute below 1
+static float maxDifference(const std::vector<float>& reference, const std::vector<float>& values) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < reference.size(); ++i) {
+        float scale = glm::max(1.0f, glm::abs(reference[i]));
+        difference = glm::max(difference, glm::abs(values[i] - reference[i]) / scale);
+    }
+    return difference;
+}
+
+// SIMD kernel against the scalar reference on the same pairs, largest difference of any output
+static void benchmarkNarrowphase() {
+    const BenchmarkScene scene = { "Dense foam", 4000, 1600.0f, 1200.0f };
+    BubbleStore bubbles = makeScene(scene, 1234u);
+    SpatialHash grid(scene.width, scene.height, BROADPHASE_CELL_SIZE);
+    std::vector<BubblePair> pairs;
+    grid.findPairs(bubbles, pairs);
+
+    const SimdLevel levels[] = { SimdLevel::Scalar, detectSimdLevel() };
+    PairDeltas results[2];
+    printf("--- Narrowphase kernel (%s, %zu pairs) ---\n", scene.name, pairs.size());
+    printf("%-10s %10s\n", "Kernel", "ms/step");
+    for (int k = 0; k < 2; ++k) {
+        Narrowphase narrowphase;
+        narrowphase.setSimdLevel(levels[k]);
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < BENCHMARK_STEPS; ++step) {
+            narrowphase.computeDeltas(bubbles, pairs, results[k]);
+        }
+        double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-10s %10.4f\n", getSimdLevelName(narrowphase.getSimdLevel()), total_ms / BENCHMARK_STEPS);
+    }
+
+    const PairDeltas& reference = results[0];
+    const PairDeltas& simd = results[1];
+    float difference = 0.0f;
+    difference = glm::max(difference, maxDifference(reference.normal_x, simd.normal_x));
+    difference = glm::max(difference, maxDifference(reference.normal_y, simd.normal_y));
+    difference = glm::max(difference, maxDifference(reference.penetration, simd.penetration));
+    difference = glm::max(difference, maxDifference(reference.force_x, simd.force_x));
+    difference = glm::max(difference, maxDifference(reference.force_y, simd.force_y));
+    difference = glm::max(difference, maxDifference(reference.correction_ax, simd.correction_ax));
+    difference = glm::max(difference, maxDifference(reference.correction_ay, simd.correction_ay));
+    difference = glm::max(difference, maxDifference(reference.correction_bx, simd.correction_bx));
+    difference = glm::max(difference, maxDifference(reference.correction_by, simd.correction_by));
+    printf("Largest difference from scalar: %g (%s)\n", difference, difference <= 1.0e-5f ? "ok" : "MISMATCH");
+}
+
+// Gravity, buoyancy and drag for a large foam with a random flow, every seventh bubble left out
+// as if asleep. The fluid is sampled once up front, only the kernel is timed.
+static void benchmarkBodyForces() {
+    const BenchmarkScene scene = { "Large foam", 100000, 4000.0f, 3000.0f };
+    BubbleStore bubbles = makeScene(scene, 1234u);
+    std::mt19937 engine(4321u);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<glm::vec2> fluid_velocities(bubbles.size());
+    std::vector<uint8_t> active(bubbles.size());
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        fluid_velocities[i] = glm::vec2(unit(engine), unit(engine)) * 30.0f;
+        active[i] = i % 7 != 0;
+    }
+    // Resting bubbles take the no-drag branch
+    for (size_t i = 0; i < bubbles.size(); i += 11) {
+        fluid_velocities[i] = bubbles[i].velocity;
+    }
+
+    const SimdLevel levels[] = { SimdLevel::Scalar, detectSimdLevel() };
+    std::vector<glm::vec2> results[2];
+    printf("--- Body force kernel (%s, %zu bubbles) ---\n", scene.name, bubbles.size());
+    printf("%-10s %10s %12s\n", "Kernel", "ms/step", "ns/bubble");
+    for (int k = 0; k < 2; ++k) {
+        BodyForces body_forces;
+        body_forces.setSimdLevel(levels[k]);
+        std::fill(bubbles.getForces(), bubbles.getForces() + bubbles.size(), glm::vec2(0.0f));
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < BENCHMARK_STEPS; ++step) {
+            body_forces.compute(bubbles, fluid_velocities.data(), active.data());
+        }
+        double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-10s %10.4f %12.3f\n", getSimdLevelName(body_forces.getSimdLevel()), total_ms / BENCHMARK_STEPS,
+            total_ms * 1.0e6 / (static_cast<double>(BENCHMARK_STEPS) * bubbles.size()));
+        results[k].assign(bubbles.getForces(), bubbles.getForces() + bubbles.size());
+    }
+
+    float difference = 0.0f;
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        difference = glm::max(difference, glm::length(results[0][i] - results[1][i]));
+    }
+    printf("Largest difference from scalar: %g (%s)\n", difference, difference <= 1.0e-3f ? "ok" : "MISMATCH");
+}
+
+// Fluid velocity at 100k points of a stirred grid, a tenth of them outside it. One getVelocityAt
+// per point against getVelocitiesAt with the scalar and detected kernels, for both sampling modes.
+static void benchmarkFluidSampling() {
+    const BenchmarkScene scene = { "Stirred grid", 4000, 1600.0f, 1200.0f };
+    BubbleStore bubbles = makeScene(scene, 1234u);
+    FluidGrid2D grid(static_cast<int>(scene.width), static_cast<int>(scene.height));
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        grid.applyBubbleForce(bubbles[i], BENCHMARK_DT);
+    }
+
+    std::mt19937 engine(4321u);
+    std::uniform_real_distribution<float> unit(-0.05f, 1.05f);
+    std::vector<glm::vec2> positions(100000);
+    for (glm::vec2& position : positions) {
+        position = glm::vec2(unit(engine) * scene.width, unit(engine) * scene.height);
+    }
+
+    const SimdLevel level = detectSimdLevel();
+    const FluidSampling modes[] = { FluidSampling::Nearest, FluidSampling::Bilinear };
+    std::vector<glm::vec2> reference(positions.size());
+    std::vector<glm::vec2> samples(positions.size());
+    printf("--- Fluid sampling (%s, %zu points) ---\n", scene.name, positions.size());
+    printf("%-9s %-12s %10s %12s %12s\n", "Sampling", "Call", "ms/step", "ns/point", "Difference");
+    for (FluidSampling mode : modes) {
+        grid.setSampling(mode);
+        for (int run = 0; run < 3; ++run) {
+            grid.setSimdLevel(run == 2 ? level : SimdLevel::Scalar);
+            std::vector<glm::vec2>& out = run == 0 ? reference : samples;
+            auto start = std::chrono::steady_clock::now();
+            for (int step = 0; step < BENCHMARK_STEPS; ++step) {
+                if (run == 0) {
+                    for (size_t i = 0; i < positions.size(); ++i) {
+                        out[i] = grid.getVelocityAt(positions[i]);
+                    }
+                }
+                else {
+                    grid.getVelocitiesAt(positions.data(), positions.size(), out.data());
+                }
+            }
+            double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            float difference = 0.0f;
+            for (size_t i = 0; i < positions.size(); ++i) {
+                difference = glm::max(difference, glm::length(out[i] - reference[i]));
+            }
+            const char* call = run == 0 ? "Per point" : getSimdLevelName(grid.getSimdLevel());
+            printf("%-9s %-12s %10.4f %12.3f %12g\n", getFluidSamplingName(mode), call, total_ms / BENCHMARK_STEPS,
+                total_ms * 1.0e6 / (static_cast<double>(BENCHMARK_STEPS) * positions.size()), difference);
+        }
+    }
+}
+
+// StableFluids updates of grids from 40x30 (the 800x600 window) to 320x240 cells, stirred every step
+// by a column of rising bubbles as the two-way coupling would, with a slanted shelf across the flow.
+// Default pressure limits, no budget.
+static void runFluidSolverScene(int width, int height, PoissonMethod method) {
+    const int warmup_steps = 30;
+    const int measured_steps = 120;
+    FluidGrid2D grid(width, height);
+    grid.setSolver(FluidSolver::StableFluids);
+    grid.setPressureMethod(method);
+    grid.addSolidSurface(Surface2D(0, glm::vec2(width * 0.15f, height * 0.6f), glm::vec2(width * 0.55f, height * 0.7f)));
+
+    BubbleStore bubbles;
+    for (int i = 0; i < 200; ++i) {
+        glm::vec2 position(width * (0.4f + 0.2f * (i % 10) / 10.0f), height * (0.1f + 0.8f * (i / 10) / 20.0f));
+        bubbles.push_back(Bubble(i, position, BUBBLE_MIN_RADIUS, glm::vec2(0.0f, 60.0f)));
+    }
+
+    double total_ms = 0.0;
+    int iterations = 0;
+    int over_budget = 0;
+    float residual = 0.0f;
+    for (int step = 0; step < warmup_steps + measured_steps; ++step) {
+        for (size_t i = 0; i < bubbles.size(); ++i) {
+            grid.applyBubbleForce(bubbles[i], SIMULATION_STEP);
+        }
+        auto start = std::chrono::steady_clock::now();
+        grid.update(SIMULATION_STEP);
+        if (step < warmup_steps) continue;
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const FluidSolveStats& stats = grid.getLastSolveStats();
+        iterations += stats.iterations;
+        over_budget += stats.over_budget ? 1 : 0;
+        residual = glm::max(residual, stats.residual);
+    }
+    const int cells = grid.getWidthCells() * grid.getHeightCells();
+    printf("%4dx%-4d %-13s %10.4f %12.1f %11.1f %12.2e %8d %9.1f\n", grid.getWidthCells(), grid.getHeightCells(),
+        getPoissonMethodName(method), total_ms / measured_steps, cells * measured_steps / total_ms / 1000.0, static_cast<double>(iterations) / measured_steps,
+        residual, over_budget, grid.getMaxSpeed());
+}
+
+static void benchmarkFluidSolver() {
+    printf("--- Stable fluids (%d iterations, tolerance %g, no budget) ---\n", FLUID_PRESSURE_ITERATIONS,
+        FLUID_PRESSURE_TOLERANCE);
+    printf("%-9s %-13s %10s %12s %11s %12s %8s %9s\n", "Cells", "Pressure", "ms/step", "Mcells/s", "Iterations", "Residual", "Over", "Max speed");
+    const PoissonMethod methods[] = { PoissonMethod::GaussSeidel, PoissonMethod::Multigrid, PoissonMethod::MultigridCG };
+    const int sizes[][2] = { { 800, 600 }, { 1600, 1200 }, { 3200, 2400 }, { 6400, 4800 } };
+    for (const int* size : sizes) {
+        for (PoissonMethod method : methods) {
+            runFluidSolverScene(size[0], size[1], method);
+        }
+    }
+}
+
+// Cold solves of the same problem on grids from 40x30 to 320x240 cells: a random right hand side
+// (zero mean over the fluid), on the open grid or with a slanted shelf, like the one in the fluid scene, as the solid.
+// Convergence is the mean residual reduction per iteration, wall time is for the whole solve.
+static void runPoissonScene(int width, int height, bool shelf, PoissonMethod method, int maxIterations) {
+    const float tolerance = 1.0e-4f;
+    const float cell_size = 800.0f / width;
+    PoissonSolver solver(width, height);
+    solver.setMethod(method);
+    if (shelf) solver.addSurface(Surface2D(0, glm::vec2(100.0f, 300.0f), glm::vec2(600.0f, 360.0f)), cell_size);
+
+    std::mt19937 engine(2024u);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<float> rhs(width * height, 0.0f);
+    double sum = 0.0;
+    int fluid_cells = 0;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (solver.isSolid(x, y)) continue;
+            rhs[y * width + x] = unit(engine);
+            sum += rhs[y * width + x];
+            fluid_cells++;
+        }
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (!solver.isSolid(x, y)) rhs[y * width + x] -= static_cast<float>(sum / fluid_cells);
+        }
+    }
+
+    std::vector<float> solution(width * height, 0.0f);
+    auto start = std::chrono::steady_clock::now();
+    const int iterations = solver.solve(solution.data(), rhs.data(), width, maxIterations, tolerance);
+    double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // The zero first guess starts at residual 1
+    const float residual = solver.computeResidual(solution.data(), rhs.data(), width);
+    const double factor = std::pow(static_cast<double>(residual), 1.0 / std::max(iterations, 1));
+    printf("%4dx%-4d %-6s %-13s %10d %10.3f %12.4f %12.2e %10.3f\n", width, height, shelf ? "shelf" : "open",
+        getPoissonMethodName(method), iterations, total_ms, total_ms / std::max(iterations, 1), residual, factor);
+}
+
+static void benchmarkPoisson() {
+    printf("--- Pressure Poisson solve (tolerance 1e-4, cold start) ---\n");
+    printf("%-9s %-6s %-13s %10s %10s %12s %12s %10s\n", "Cells", "Solid", "Method", "Iterations", "ms", "ms/iteration", "Residual", "Factor");
+    const int sizes[][2] = { { 40, 30 }, { 80, 60 }, { 160, 120 }, { 320, 240 } };
+    for (int shelf = 0; shelf < 2; ++shelf) {
+        for (const int* size : sizes) {
+            runPoissonScene(size[0], size[1], shelf != 0, PoissonMethod::GaussSeidel, 2000);
+            runPoissonScene(size[0], size[1], shelf != 0, PoissonMethod::Multigrid, 100);
+            runPoissonScene(size[0], size[1], shelf != 0, PoissonMethod::MultigridCG, 100);
+        }
+    }
+}
+
+// Dense cluster of small bubbles, the stiffest case for the contact springs (their mass goes with r^2).
+// Fusion and sleeping are off and the world is tall enough that nothing leaves, so every bubble of a
+// run can be compared with the same bubble of the reference run.
+static BubbleStore runContactScene(IntegrationMode mode, float dt, float duration, double& totalMs, float& maxSpeed) {
+    const float width = 800.0f;
+    const float height = 20000.0f;
+    BubbleSimulator simulator(static_cast<int>(width), static_cast<int>(height));
+    simulator.setSeed(1234u);
+    simulator.setFusionProbability(0.0f);
+    simulator.setSleepingEnabled(false);
+    simulator.setIntegrationMode(mode);
+
+    std::mt19937 engine(1234u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    BubbleStore bubbles;
+    for (int i = 0; i < 300; ++i) {
+        glm::vec2 position(350.0f + unit(engine) * 100.0f, 50.0f + unit(engine) * 100.0f);
+        bubbles.push_back(Bubble(i, position, 2.0f + unit(engine) * 2.0f));
+    }
+
+    const int steps = static_cast<int>(duration / dt + 0.5f);
+    maxSpeed = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; ++step) {
+        simulator.update(dt, bubbles);
+        const glm::vec2* velocities = bubbles.getVelocities();
+        for (size_t i = 0; i < bubbles.size(); ++i) {
+            maxSpeed = glm::max(maxSpeed, glm::length(velocities[i]));
+        }
+    }
+    totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return bubbles;
+}
+
+// Same simulated second at growing dt for every integrator. The error is the RMS distance of every
+// bubble from where a small-dt explicit run put it; a run is unstable once its speeds run away.
+static void benchmarkIntegrators() {
+    const float duration = 1.0f;
+    const float rates[] = { 240.0f, 120.0f, 60.0f, 30.0f, 15.0f, 10.0f, 8.0f };
+    const IntegrationMode modes[] = { IntegrationMode::Explicit, IntegrationMode::Implicit, IntegrationMode::Xpbd };
+
+    double reference_ms;
+    float reference_speed;
+    BubbleStore reference = runContactScene(IntegrationMode::Explicit, 1.0f / 1920.0f, duration, reference_ms, reference_speed);
+
+    printf("--- Integrators (small bubble cluster, %.0f s simulated, reference explicit at 1920 Hz) ---\n", duration);
+    printf("%-10s %6s %10s %10s %10s\n", "Mode", "Hz", "steps/s", "RMS error", "max speed");
+    for (float rate : rates) {
+        for (IntegrationMode mode : modes) {
+            double total_ms;
+            float max_speed;
+            BubbleStore bubbles = runContactScene(mode, 1.0f / rate, duration, total_ms, max_speed);
+
+            double error = 0.0;
+            bool stable = bubbles.size() == reference.size() && max_speed < 10.0f * reference_speed;
+            if (stable) {
+                const glm::vec2* positions = bubbles.getPositions();
+                const glm::vec2* reference_positions = reference.getPositions();
+                for (size_t i = 0; i < bubbles.size(); ++i) {
+                    error += glm::length2(positions[i] - reference_positions[i]);
+                }
+                error = std::sqrt(error / bubbles.size());
+                stable = std::isfinite(error);
+            }
+            const double steps_per_second = rate * duration / (total_ms / 1000.0);
+            if (stable) {
+                printf("%-10s %6.0f %10.0f %10.3f %10.1f\n", getIntegrationModeName(mode), rate, steps_per_second, error, max_speed);
+            }
+            else {
+                printf("%-10s %6.0f %10.0f %10s %10s\n", getIntegrationModeName(mode), rate, steps_per_second, "UNSTABLE", "-");
+            }
+        }
+    }
+}
+
+// Generator and simulator running on a full pool. After the warm-up every scratch buffer has
+// reached its high-water mark, so the measured steps should not allocate at all.
+static void runPoolScene(SpawnPolicy policy) {
+    const BenchmarkScene scene = { "Full pool", 1000, 1200.0f, 900.0f };
+    const int warmup_steps = 600;
+    const int spawn_attempts = 100; // Generator calls per step, far more than the pool has room for
+
+    BubbleGenerator generator;
+    generator.bubbles.setCapacity(scene.bubble_count);
+    generator.setSpawnPolicy(policy);
+    BubbleSimulator simulator(static_cast<int>(scene.width), static_cast<int>(scene.height));
+    simulator.setSeed(1234u);
+    Surface2D bottom(0, glm::vec2(50.0f, 50.0f), glm::vec2(scene.width - 50.0f, 50.0f), 0.8f, 0.3f, true);
+    bottom.normal = glm::vec2(0.0f, 1.0f);
+    simulator.addSurface(bottom);
+    generator.generateInitialRandomBubbles(scene.bubble_count, scene.width, scene.height);
+
+    double total_ms = 0.0;
+    size_t allocations = 0;
+    for (int step = 0; step < warmup_steps + BENCHMARK_STEPS; ++step) {
+        size_t allocations_before = getAllocationCount();
+        auto start = std::chrono::steady_clock::now();
+        for (int attempt = 0; attempt < spawn_attempts; ++attempt) {
+            generator.tryGenerateBubbles(simulator.getSurfaces(), BENCHMARK_DT, scene.width, scene.height);
+        }
+        simulator.update(BENCHMARK_DT, generator.bubbles);
+        if (step < warmup_steps) continue;
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        allocations += getAllocationCount() - allocations_before;
+    }
+    printf("%-16s %10.3f %8zu %9zu %9zu %12zu\n", getSpawnPolicyName(policy), total_ms / BENCHMARK_STEPS,
+        generator.bubbles.size(), generator.getRejectedCount(), generator.getRecycledCount(), allocations);
+}
+
+static void benchmarkPool() {
+    const SpawnPolicy policies[] = { SpawnPolicy::Reject, SpawnPolicy::RecycleOldest, SpawnPolicy::RecycleHighest };
+
+    printf("--- Bubble pool (capacity 1000, %d steps after warm-up) ---\n", BENCHMARK_STEPS);
+    printf("%-16s %10s %8s %9s %9s %12s\n", "Policy", "ms/step", "Bubbles", "Rejected", "Recycled", "Allocations");
+    for (SpawnPolicy policy : policies) {
+        runPoolScene(policy);
+    }
+}
+
+// 60 Hz frames through a SimulationClock, at SIMULATION_STEP or at the step computeStableStep picks
+// every frame. Calm: a few bubbles rising apart at their terminal speed. Burst: a dense cluster
+// released at the start of the measured seconds. The world is tall enough that none leave it.
+static void runSteppingScene(const char* name, bool burst, bool adaptive) {
+    const float width = 800.0f;
+    const float height = 4000.0f;
+    const float frame = 1.0f / 60.0f;
+    const int settle_frames = burst ? 0 : 60;
+    const int measured_frames = 180;
+
+    BubbleSimulator simulator(static_cast<int>(width), static_cast<int>(height));
+    simulator.setSeed(1234u);
+    simulator.setFusionProbability(0.0f); // The fusion chance is per step, it would differ between the two
+
+    std::mt19937 engine(1234u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    BubbleStore bubbles;
+    const int bubble_count = burst ? 300 : 20;
+    for (int i = 0; i < bubble_count; ++i) {
+        glm::vec2 position = burst ? glm::vec2(250.0f + unit(engine) * 300.0f, 30.0f + unit(engine) * 120.0f)
+                                   : glm::vec2(60.0f + unit(engine) * (width - 120.0f), 30.0f + unit(engine) * 400.0f);
+        bubbles.push_back(Bubble(i, position, BUBBLE_MIN_RADIUS + unit(engine) * 4.0f));
+    }
+
+    SimulationClock clock(SIMULATION_STEP, SIMULATION_MAX_SUBSTEPS);
+    int steps = 0;
+    double total_ms = 0.0;
+    float max_speed = 0.0f;
+    for (int f = 0; f < settle_frames + measured_frames; ++f) {
+        const bool measured = f >= settle_frames;
+        auto start = std::chrono::steady_clock::now();
+        if (adaptive) clock.setFixedStep(simulator.computeStableStep(bubbles));
+        const int substeps = clock.advance(frame);
+        for (int s = 0; s < substeps; ++s) {
+            simulator.update(clock.getFixedStep(), bubbles);
+        }
+        if (!measured) continue;
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        steps += substeps;
+        const glm::vec2* velocities = bubbles.getVelocities();
+        for (size_t i = 0; i < bubbles.size(); ++i) {
+            max_speed = glm::max(max_speed, glm::length(velocities[i]));
+        }
+    }
+    const float seconds = measured_frames * frame;
+    printf("%-6s %-9s %10.1f %9.2f %12.2f %10.1f %8zu\n", name, adaptive ? "Adaptive" : "Fixed", steps / seconds,
+        seconds * 1000.0f / steps, total_ms / seconds, max_speed, bubbles.size());
+}
+
+static void benchmarkAdaptiveStep() {
+    printf("--- Adaptive step (60 Hz frames, 3 s measured, fixed step %.2f ms) ---\n", SIMULATION_STEP * 1000.0f);
+    printf("%-6s %-9s %10s %9s %12s %10s %8s\n", "Scene", "Step", "steps/s", "mean ms", "ms per sim s", "max speed", "Bubbles");
+    runSteppingScene("Calm", false, false);
+    runSteppingScene("Calm", false, true);
+    runSteppingScene("Burst", true, false);
+    runSteppingScene("Burst", true, true);
+}
+
+// Bubbles caught under four shelves, growing in place as they would at nucleation sites, stepped at
+// SIMULATION_STEP with and without the slow lane. Fusion and sleeping are off so only the lanes differ.
+static void runShelfScene(bool multirate) {
+    const float width = 1200.0f;
+    const float height = 800.0f;
+    const int warmup_steps = 240;
+    const int measured_steps = 480;
+
+    BubbleSimulator simulator(static_cast<int>(width), static_cast<int>(height));
+    simulator.setSeed(1234u);
+    simulator.setFusionProbability(0.0f);
+    simulator.setSleepingEnabled(false);
+    simulator.setMultirateEnabled(multirate);
+
+    BubbleStore bubbles;
+    for (int shelf = 0; shelf < 4; ++shelf) {
+        const float y = 150.0f + shelf * 150.0f;
+        Surface2D ceiling(shelf, glm::vec2(50.0f, y), glm::vec2(width - 50.0f, y));
+        ceiling.normal = glm::vec2(0.0f, -1.0f);
+        simulator.addSurface(ceiling);
+        for (float x = 70.0f; x < width - 70.0f; x += 24.0f) {
+            bubbles.push_back(Bubble(static_cast<int>(bubbles.size()), glm::vec2(x, y - 20.0f), 6.0f));
+        }
+    }
+
+    double total_ms = 0.0;
+    size_t held = 0;
+    size_t on_surface = 0;
+    for (int step = 0; step < warmup_steps + measured_steps; ++step) {
+        auto start = std::chrono::steady_clock::now();
+        simulator.update(SIMULATION_STEP, bubbles);
+        if (step < warmup_steps) continue;
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        held += simulator.getHeldCount();
+        for (size_t i = 0; i < bubbles.size(); ++i) {
+            on_surface += bubbles[i].on_surface;
+        }
+    }
+    printf("%-10s %8zu %10.1f %10.1f %10.3f\n", multirate ? "Multi-rate" : "Every step", bubbles.size(),
+        static_cast<double>(on_surface) / measured_steps, static_cast<double>(held) / measured_steps, total_ms / measured_steps);
+}
+
+static void benchmarkMultirate() {
+    printf("--- Slow lane (bubbles under shelves, every %d steps when attached) ---\n", MULTIRATE_INTERVAL);
+    printf("%-10s %8s %10s %10s %10s\n", "Lanes", "Bubbles", "Attached", "Held", "ms/step");
+    runShelfScene(false);
+    runShelfScene(true);
+}
+
+// Rising bubbles between three tilted shelves, stepped at SIMULATION_STEP on one thread so the time
+// is the step's work and not the pool's scheduling. Fusion is rolled with probability 0, so every
+// feature set steps the same 1500 bubbles and the rows compare like for like; with fusion on the
+// rolls are still made. Returns ms per measured step.
+static double runFeatureScene(const SimulationFeatures& features) {
+    const float width = 1200.0f;
+    const float height = 4000.0f;
+    const int warmup_steps = 60;
+    const int measured_steps = 240;
+
+    BubbleSimulator simulator(static_cast<int>(width), static_cast<int>(height));
+    simulator.setSeed(1234u);
+    simulator.setFeatures(features);
+    simulator.setFusionProbability(0.0f);
+    simulator.setSleepingEnabled(false);
+    simulator.setThreadCount(1);
+
+    for (int shelf = 0; shelf < 3; ++shelf) {
+        const float y = 400.0f + shelf * 300.0f;
+        Surface2D ceiling(shelf, glm::vec2(50.0f, y), glm::vec2(width - 50.0f, y + 60.0f));
+        ceiling.normal = glm::normalize(glm::vec2(0.05f, -1.0f));
+        simulator.addSurface(ceiling);
+    }
+
+    std::mt19937 engine(1234u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    BubbleStore bubbles;
+    for (int i = 0; i < 1500; ++i) {
+        glm::vec2 position(60.0f + unit(engine) * (width - 120.0f), 30.0f + unit(engine) * 1200.0f);
+        bubbles.push_back(Bubble(i, position, BUBBLE_MIN_RADIUS + unit(engine) * 4.0f));
+    }
+
+    double total_ms = 0.0;
+    for (int step = 0; step < warmup_steps + measured_steps; ++step) {
+        auto start = std::chrono::steady_clock::now();
+        simulator.update(SIMULATION_STEP, bubbles);
+        if (step < warmup_steps) continue;
+        total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return total_ms / measured_steps;
+}
+
+// Every repetition runs each feature set once, in turn, so a slow stretch of the machine (clock
+// changes, other processes) lands on all of them instead of on whichever ran then. Each row turns
+// one feature off (lift on) against the default set in the first row.
+static void benchmarkFeatures() {
+    struct FeatureRun {
+        const char* name;
+        SimulationFeatures features;
+    };
+    const FeatureRun runs[] = {
+        { "Default", DEFAULT_SIMULATION_FEATURES },
+        { "No fusion", { false, true, true, false } },
+        { "No adhesion", { true, false, true, false } },
+        { "No coupling", { true, true, false, false } },
+        { "With lift", { true, true, true, true } },
+        { "None", { false, false, false, false } },
+    };
+    const int run_count = sizeof(runs) / sizeof(runs[0]);
+    const int repetitions = 7;
+    std::vector<std::vector<double>> ms(run_count);
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        for (int r = 0; r < run_count; ++r) {
+            ms[r].push_back(runFeatureScene(runs[r].features));
+        }
+    }
+
+    printf("--- Step features (1500 rising bubbles, no fusions, 3 shelves, 1 thread, %d repetitions) ---\n", repetitions);
+    printf("%-14s %10s %10s %10s\n", "Features", "Median ms", "Min ms", "vs first");
+    double first_ms = 0.0;
+    for (int r = 0; r < run_count; ++r) {
+        std::sort(ms[r].begin(), ms[r].end());
+        const double median = ms[r][repetitions / 2];
+        if (r == 0) first_ms = median;
+        printf("%-14s %10.3f %10.3f %9.1f%%\n", runs[r].name, median, ms[r].front(), (median / first_ms - 1.0) * 100.0);
+    }
+}
+
+void runBenchmarks() {
+    benchmarkBroadphases();
+    benchmarkSurfaces();
+    benchmarkNarrowphase();
+    benchmarkBodyForces();
+    benchmarkFluidSampling();
+    benchmarkPoisson();
+    benchmarkFluidSolver();
+    benchmarkPool();
+    benchmarkIntegrators();
+    benchmarkAdaptiveStep();
+    benchmarkMultirate();
+    benchmarkFeatures();
+}
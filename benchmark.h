@@ -0,0 +1,8 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Headless benchmarks, run with "BubbleTests --bench".
+// Every scene is generated from a fixed seed so results are comparable between runs.
+void runBenchmarks();
+
+#endif
@@ -0,0 +1,148 @@
+#include "BodyForces.h"
+#include <cstring>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#elif defined(SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+// BubbleStore arrays read and written by the kernels
+struct BodyForceArrays {
+    const glm::vec2* velocity;
+    const glm::vec2* fluid_velocity;
+    const float* radius;
+    const float* mass;
+    const uint8_t* active;
+    glm::vec2* force;
+};
+
+static void computeScalar(const BodyForceArrays& io, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        if (!io.active[i]) continue;
+        io.force[i] = computeBodyForce(io.velocity[i], io.fluid_velocity[i], io.radius[i], io.mass[i]);
+    }
+}
+
+#if defined(SIMD_X86)
+// 4 bubbles per iteration, kept interleaved as (x, y) lanes so vec2 arrays load and store directly.
+// Per-bubble scalars are duplicated into both lanes of their bubble.
+SIMD_AVX2_TARGET
+static size_t computeAvx2(const BodyForceArrays& io, size_t begin, size_t end) {
+    const __m256 gravity = _mm256_setr_ps(GRAVITY.x, GRAVITY.y, GRAVITY.x, GRAVITY.y, GRAVITY.x, GRAVITY.y, GRAVITY.x, GRAVITY.y);
+    const __m256 neg_gravity = _mm256_setr_ps(-GRAVITY.x, -GRAVITY.y, -GRAVITY.x, -GRAVITY.y, -GRAVITY.x, -GRAVITY.y, -GRAVITY.x, -GRAVITY.y);
+    const __m256 pi = _mm256_set1_ps(glm::pi<float>());
+    const __m256 water_density = _mm256_set1_ps(WATER_DENSITY);
+    const __m256 neg_drag = _mm256_set1_ps(-FLUID_DRAG_COEFFICIENT);
+    const __m256 min_speed_sq = _mm256_set1_ps(0.000001f);
+    const __m256 min_radius = _mm256_set1_ps(0.01f);
+    const __m256i duplicate = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        int active_bytes;
+        std::memcpy(&active_bytes, io.active + i, sizeof(active_bytes));
+        if (active_bytes == 0) continue;
+        __m128i active_pairs = _mm_unpacklo_epi8(_mm_cvtsi32_si128(active_bytes), _mm_cvtsi32_si128(active_bytes));
+        __m256 active = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_cvtepu8_epi32(active_pairs), _mm256_setzero_si256()));
+
+        __m256 velocity = _mm256_loadu_ps(&io.velocity[i].x);
+        __m256 fluid_velocity = _mm256_loadu_ps(&io.fluid_velocity[i].x);
+        __m256 radius = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(io.radius + i)), duplicate);
+        __m256 mass = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_loadu_ps(io.mass + i)), duplicate);
+
+        __m256 force = _mm256_mul_ps(gravity, mass);
+        __m256 displaced_fluid_mass = _mm256_mul_ps(water_density, _mm256_mul_ps(_mm256_mul_ps(pi, radius), radius));
+        force = _mm256_add_ps(force, _mm256_mul_ps(neg_gravity, displaced_fluid_mass));
+
+        __m256 relative_velocity = _mm256_sub_ps(velocity, fluid_velocity);
+        __m256 squares = _mm256_mul_ps(relative_velocity, relative_velocity);
+        // x * x + y * y in both lanes of each bubble
+        __m256 relative_speed_sq = _mm256_add_ps(squares, _mm256_permute_ps(squares, 0xB1));
+        __m256 dragging = _mm256_and_ps(_mm256_cmp_ps(relative_speed_sq, min_speed_sq, _CMP_GT_OQ),
+            _mm256_cmp_ps(radius, min_radius, _CMP_GT_OQ));
+        __m256 relative_speed = _mm256_sqrt_ps(relative_speed_sq);
+        __m256 paper_factor = _mm256_div_ps(mass, radius);
+        __m256 drag = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(neg_drag, paper_factor), relative_speed), relative_velocity);
+        // Lanes without drag may hold inf/nan, the mask zeroes them
+        force = _mm256_add_ps(force, _mm256_and_ps(drag, dragging));
+
+        __m256 previous = _mm256_loadu_ps(&io.force[i].x);
+        _mm256_storeu_ps(&io.force[i].x, _mm256_blendv_ps(previous, force, active));
+    }
+    return i;
+}
+#endif
+
+#if defined(SIMD_NEON)
+// 2 bubbles per iteration, interleaved like the AVX2 kernel
+static size_t computeNeon(const BodyForceArrays& io, size_t begin, size_t end) {
+    const float gravity_lanes[4] = { GRAVITY.x, GRAVITY.y, GRAVITY.x, GRAVITY.y };
+    const float neg_gravity_lanes[4] = { -GRAVITY.x, -GRAVITY.y, -GRAVITY.x, -GRAVITY.y };
+    const float32x4_t gravity = vld1q_f32(gravity_lanes);
+    const float32x4_t neg_gravity = vld1q_f32(neg_gravity_lanes);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+
+    size_t i = begin;
+    for (; i + 2 <= end; i += 2) {
+        if (!io.active[i] && !io.active[i + 1]) continue;
+        const uint32_t active_lanes[4] = {
+            io.active[i] ? ~0u : 0u, io.active[i] ? ~0u : 0u, io.active[i + 1] ? ~0u : 0u, io.active[i + 1] ? ~0u : 0u };
+        uint32x4_t active = vld1q_u32(active_lanes);
+
+        float32x4_t velocity = vld1q_f32(&io.velocity[i].x);
+        float32x4_t fluid_velocity = vld1q_f32(&io.fluid_velocity[i].x);
+        float32x2_t radius_pair = vld1_f32(io.radius + i);
+        float32x2_t mass_pair = vld1_f32(io.mass + i);
+        float32x4_t radius = vcombine_f32(vdup_lane_f32(radius_pair, 0), vdup_lane_f32(radius_pair, 1));
+        float32x4_t mass = vcombine_f32(vdup_lane_f32(mass_pair, 0), vdup_lane_f32(mass_pair, 1));
+
+        float32x4_t force = vmulq_f32(gravity, mass);
+        float32x4_t displaced_fluid_mass = vmulq_n_f32(vmulq_f32(vmulq_n_f32(radius, glm::pi<float>()), radius), WATER_DENSITY);
+        force = vaddq_f32(force, vmulq_f32(neg_gravity, displaced_fluid_mass));
+
+        float32x4_t relative_velocity = vsubq_f32(velocity, fluid_velocity);
+        float32x4_t squares = vmulq_f32(relative_velocity, relative_velocity);
+        float32x4_t relative_speed_sq = vaddq_f32(squares, vrev64q_f32(squares));
+        uint32x4_t dragging = vandq_u32(vcgtq_f32(relative_speed_sq, vdupq_n_f32(0.000001f)), vcgtq_f32(radius, vdupq_n_f32(0.01f)));
+        float32x4_t relative_speed = vsqrtq_f32(relative_speed_sq);
+        float32x4_t paper_factor = vdivq_f32(mass, radius);
+        float32x4_t drag = vmulq_f32(vmulq_f32(vmulq_n_f32(paper_factor, -FLUID_DRAG_COEFFICIENT), relative_speed), relative_velocity);
+        force = vaddq_f32(force, vbslq_f32(dragging, drag, zero));
+
+        vst1q_f32(&io.force[i].x, vbslq_f32(active, force, vld1q_f32(&io.force[i].x)));
+    }
+    return i;
+}
+#endif
+
+BodyForces::BodyForces()
+    : simd_level(detectSimdLevel()) {
+}
+
+void BodyForces::setSimdLevel(SimdLevel level) {
+    simd_level = level == detectSimdLevel() ? level : SimdLevel::Scalar;
+}
+
+void BodyForces::compute(BubbleStore& bubbles, const glm::vec2* fluidVelocities, const uint8_t* active) {
+    const BodyForceArrays io = { bubbles.getVelocities(), fluidVelocities, bubbles.getRadii(), bubbles.getMasses(),
+        active, bubbles.getForces() };
+    const size_t count = bubbles.size();
+
+    size_t done = 0;
+    switch (simd_level) {
+#if defined(SIMD_X86)
+    case SimdLevel::Avx2:
+        done = computeAvx2(io, 0, count);
+        break;
+#endif
+#if defined(SIMD_NEON)
+    case SimdLevel::Neon:
+        done = computeNeon(io, 0, count);
+        break;
+#endif
+    default:
+        break;
+    }
+    computeScalar(io, done, count);
+}
@@ -0,0 +1,51 @@
+#ifndef BODY_FORCES_H
+#define BODY_FORCES_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include "BubbleStore.h"
+#include "Simd.h"
+#include "SimulationConstants.h"
+
+// Gravity, buoyancy and drag on one bubble, with the fluid velocity at its position.
+// Reference for the SIMD kernels, which follow the same operations in the same order lane by lane.
+inline glm::vec2 computeBodyForce(glm::vec2 velocity, glm::vec2 fluidVelocity, float radius, float mass) {
+    // Gravity
+    glm::vec2 force = GRAVITY * mass;
+
+    // Buoyancy, the weight of the displaced water: F_b = -rho_liq * V_bubble * g
+    float displaced_fluid_mass = WATER_DENSITY * (glm::pi<float>() * radius * radius);
+    force += -GRAVITY * displaced_fluid_mass;
+
+    // Drag F_d = -k_drag * (m_i / r_i) * |v_rel| * v_rel
+    glm::vec2 relative_velocity = velocity - fluidVelocity;
+    float relative_speed_sq = glm::dot(relative_velocity, relative_velocity);
+    if (relative_speed_sq > 0.000001f && radius > 0.01f) { // Avoid division by zero
+        float relative_speed = glm::sqrt(relative_speed_sq);
+        float paper_factor = mass / radius;
+        force += -FLUID_DRAG_COEFFICIENT * paper_factor * relative_speed * relative_velocity;
+    }
+    return force;
+}
+
+// Fused body force pass. One sweep over the store's arrays computes gravity, buoyancy and drag
+// of every active bubble, several bubbles per instruction where the CPU allows it.
+// The fluid velocities are sampled beforehand (FluidGrid2D::getVelocitiesAt), so the kernel
+// only streams contiguous arrays.
+class BodyForces {
+public:
+    BodyForces();
+
+    // Overwrites the force of every bubble i with active[i] != 0, the others keep theirs.
+    // fluidVelocities has one entry per bubble.
+    void compute(BubbleStore& bubbles, const glm::vec2* fluidVelocities, const uint8_t* active);
+
+    // Forces a kernel, e.g. the scalar one as a reference. Unsupported levels fall back to scalar.
+    void setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel() const { return simd_level; }
+
+private:
+    SimdLevel simd_level;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "Broadphase.h"
+#include "SpatialHash.h"
+#include "SortAndSweep.h"
+#include "AabbTree.h"
+#include "VerletList.h"
+#include <glm/glm.hpp>
+
+const char* getBroadphaseName(BroadphaseMode mode) {
+    switch (mode) {
+    case BroadphaseMode::BruteForce: return "Brute force";
+    case BroadphaseMode::SpatialHash: return "Spatial hash";
+    case BroadphaseMode::SortAndSweep: return "Sort and sweep";
+    case BroadphaseMode::AabbTree: return "AABB tree";
+    case BroadphaseMode::VerletList: return "Verlet lists";
+    }
+    return "Unknown";
+}
+
+std::unique_ptr<Broadphase> createBroadphase(BroadphaseMode mode, float worldWidth, float worldHeight) {
+    switch (mode) {
+    case BroadphaseMode::BruteForce:
+        return std::unique_ptr<Broadphase>(new BruteForceBroadphase());
+    case BroadphaseMode::SortAndSweep:
+        return std::unique_ptr<Broadphase>(new SortAndSweep());
+    case BroadphaseMode::AabbTree:
+        return std::unique_ptr<Broadphase>(new AabbTree());
+    case BroadphaseMode::VerletList:
+        return std::unique_ptr<Broadphase>(new VerletList(worldWidth, worldHeight, VERLET_SKIN));
+    case BroadphaseMode::SpatialHash:
+    default:
+        return std::unique_ptr<Broadphase>(new SpatialHash(worldWidth, worldHeight, BROADPHASE_CELL_SIZE));
+    }
+}
+
+void Broadphase::sortPairs(std::vector<BubblePair>& pairs, int bubbleCount) {
+    // LSD radix: sort by b first, then a stable pass by a
+    sortPairsBy(pairs, bubbleCount, &BubblePair::b);
+    sortPairsBy(pairs, bubbleCount, &BubblePair::a);
+}
+
+void Broadphase::sortPairsBy(std::vector<BubblePair>& pairs, int bubbleCount, int BubblePair::* key) {
+    pair_offsets.assign(bubbleCount + 1, 0);
+    for (const BubblePair& pair : pairs) {
+        pair_offsets[pair.*key + 1]++;
+    }
+    for (int k = 0; k < bubbleCount; ++k) {
+        pair_offsets[k + 1] += pair_offsets[k];
+    }
+    sorted_pairs.resize(pairs.size());
+    for (const BubblePair& pair : pairs) {
+        sorted_pairs[pair_offsets[pair.*key]++] = pair;
+    }
+    pairs.swap(sorted_pairs);
+}
+
+void BruteForceBroadphase::findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) {
+    pairs.clear();
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        if (bubbles[i].marked_for_removal) continue;
+        const glm::vec2 extent_i(bubbles[i].radius + BROADPHASE_MARGIN);
+        const glm::vec2 min_i = bubbles[i].position - extent_i;
+        const glm::vec2 max_i = bubbles[i].position + extent_i;
+
+        for (size_t j = i + 1; j < bubbles.size(); ++j) {
+            if (bubbles[j].marked_for_removal) continue;
+            // Same bounds test as the other broadphases, margin included
+            const glm::vec2 extent_j(bubbles[j].radius + BROADPHASE_MARGIN);
+            const glm::vec2 min_j = bubbles[j].position - extent_j;
+            const glm::vec2 max_j = bubbles[j].position + extent_j;
+            if (min_j.x < max_i.x && min_i.x < max_j.x && min_j.y < max_i.y && min_i.y < max_j.y) {
+                pairs.push_back({ static_cast<int>(i), static_cast<int>(j) });
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <vector>
+#include <memory>
+#include "BubbleStore.h"
+
+// Pair of bubble indices (a < b) that may be touching.
+struct BubblePair {
+    int a;
+    int b;
+};
+
+// Available bubble-bubble broadphases.
+enum class BroadphaseMode {
+    BruteForce,   // Tests every pair, reference for the others
+    SpatialHash,  // Uniform grid rebuilt every step
+    SortAndSweep, // Persistent x-sorted interval list updated by insertion sort
+    AabbTree,     // Dynamic bounding volume tree with fattened leaves
+    VerletList    // Cached neighbour lists with a skin, rebuilt on demand
+};
+
+const char* getBroadphaseName(BroadphaseMode mode);
+
+// Shared interface so every broadphase can drive the same narrowphase (and be benchmarked on the same scenes).
+class Broadphase {
+public:
+    virtual ~Broadphase() = default;
+
+    // Writes candidate pairs for this step, ordered by a, then b (the brute-force i/j order).
+    // Every pair of live bubbles that overlaps must be reported; extra pairs are allowed.
+    virtual void findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) = 0;
+
+    // Drops any state cached between steps (e.g. after fusion changed radii and removed bubbles)
+    virtual void invalidate() {}
+
+protected:
+    // Orders pairs by (a, b) with two stable counting sorts, linear in pairs + bubbles
+    void sortPairs(std::vector<BubblePair>& pairs, int bubbleCount);
+
+private:
+    std::vector<int> pair_offsets;        // Counting sort buckets
+    std::vector<BubblePair> sorted_pairs; // Counting sort output, swapped with the caller's list
+
+    void sortPairsBy(std::vector<BubblePair>& pairs, int bubbleCount, int BubblePair::* key);
+};
+
+// Checks the bounds of every live pair. O(n^2), kept as the reference result.
+class BruteForceBroadphase : public Broadphase {
+public:
+    void findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) override;
+};
+
+std::unique_ptr<Broadphase> createBroadphase(BroadphaseMode mode, float worldWidth, float worldHeight);
+
+#endif
@@ -19,6 +19,14 @@ struct Bubble {
     bool on_surface;        // If the bubble is currently on a surface.
     int surface_id;         // Surface id for it's properties
     float time_on_surface; 
+    glm::vec2 surface_normal; // Normal of the surface it rests on, valid while on_surface
+
+    bool sleeping;          // Held still on a surface, skipped by the simulation loops until woken
+    int quiet_steps;        // Consecutive steps it stayed still on a surface
+    int sleep_contacts;     // Bubbles it was touching when it fell asleep
+
+    bool slow_lane;         // Still on a surface, only advanced every MULTIRATE_INTERVAL steps
+    float lane_time;        // Time it has not been advanced through yet, caught up on its next update
 
     bool marked_for_removal; // Flag for bubbles that have fused or should be removed
 
@@ -33,7 +41,9 @@ struct Bubble {
     Bubble(int id_val = 0, glm::vec2 pos_val = glm::vec2(0.0f, 0.0f), float rad_val = 10.0f, glm::vec2 vel_val = glm::vec2(0.0f, 0.0f))
         : id(id_val), position(pos_val), velocity(vel_val), radius(rad_val),
         mass(calculateMass(rad_val)), force_accumulator(0.0f, 0.0f),
-        on_surface(false), surface_id(-1), time_on_surface(0.0f),
+        on_surface(false), surface_id(-1), time_on_surface(0.0f), surface_normal(0.0f, 1.0f),
+        sleeping(false), quiet_steps(0), sleep_contacts(0),
+        slow_lane(false), lane_time(0.0f),
         marked_for_removal(false) {
     }
 
@@ -7,12 +7,58 @@
 const float INITIAL_SPAWN_RADIUS_MIN = 8.0f;  // Example: aligned with new BUBBLE_MIN_RADIUS
 const float INITIAL_SPAWN_RADIUS_MAX = 15.0f; // Example: slightly larger than min, but not full max
 
+const char* getSpawnPolicyName(SpawnPolicy policy) {
+    switch (policy) {
+    case SpawnPolicy::Reject: return "Reject";
+    case SpawnPolicy::RecycleOldest: return "Recycle oldest";
+    case SpawnPolicy::RecycleHighest: return "Recycle highest";
+    }
+    return "Unknown";
+}
+
 BubbleGenerator::BubbleGenerator()
     : next_bubble_id(0),
+    spawn_policy(SpawnPolicy::Reject),
+    rejected_count(0),
+    recycled_count(0),
     random_engine(std::random_device{}()),
     random_dist_prob(0.0f, 1.0f),
     random_dist_pos_offset(-1.0f, 1.0f)
 {
+    bubbles.setCapacity(BUBBLE_POOL_CAPACITY);
+}
+
+bool BubbleGenerator::spawnBubble(const Bubble& bubble) {
+    if (bubbles.isFull()) {
+        int victim = spawn_policy == SpawnPolicy::Reject ? -1 : findRecycleVictim();
+        if (victim < 0) {
+            rejected_count++;
+            return false;
+        }
+        bubbles.markForRemoval(victim);
+        bubbles.removeMarked();
+        recycled_count++;
+    }
+    bubbles.push_back(bubble);
+    return true;
+}
+
+// Linear scan, only runs when the pool is full
+int BubbleGenerator::findRecycleVictim() const {
+    const BubbleStore& pool = bubbles;
+    int victim = -1;
+    for (size_t i = 0; i < pool.size(); ++i) {
+        ConstBubbleRef bubble = pool[i];
+        if (bubble.marked_for_removal) continue;
+        if (victim < 0) {
+            victim = static_cast<int>(i);
+            continue;
+        }
+        ConstBubbleRef best = pool[victim];
+        bool better = spawn_policy == SpawnPolicy::RecycleOldest ? bubble.id < best.id : bubble.position.y > best.position.y;
+        if (better) victim = static_cast<int>(i);
+    }
+    return victim;
 }
 
 void BubbleGenerator::generateInitialRandomBubbles(int count, float screenWidth, float screenHeight) {
@@ -22,7 +68,7 @@ void BubbleGenerator::generateInitialRandomBubbles(int count, float screenWidth,
         float y = random_dist_prob(random_engine) * (screenHeight - 50.0f) + 25.0f;
         float radius = random_dist_prob(random_engine) * (INITIAL_SPAWN_RADIUS_MAX - INITIAL_SPAWN_RADIUS_MIN) + INITIAL_SPAWN_RADIUS_MIN;
 
-        bubbles.emplace_back(getNextBubbleID(), glm::vec2(x, y), radius);
+        if (!spawnBubble(Bubble(getNextBubbleID(), glm::vec2(x, y), radius))) break;
     }
 }
 
@@ -57,16 +103,12 @@ void BubbleGenerator::tryGenerateBubbles(const std::vector<Surface2D>& surfaces,
                     new_bubble.time_on_surface = 0.0f;
                     // Bubbles generated on a surface initially have zero velocity or a tiny push.
                     // The simulation will then apply buoyancy, etc.
-                    bubbles.push_back(new_bubble);
+                    spawnBubble(new_bubble);
                     // std::cout << "Generated bubble " << new_bubble.id << " at (" << gen_pos.x << "," << gen_pos.y << ") on surface " << surface.id << std::endl;
                 }
             }
         }
     }
-    // Limit total number of bubbles for performance if needed
-   // const size_t MAX_BUBBLES = 200;
-   // if (bubbles.size() > MAX_BUBBLES) {
-   //    bubbles.erase(bubbles.begin(), bubbles.begin() + (bubbles.size() - MAX_BUBBLES));
-   // }
+    // The pool capacity (BUBBLE_POOL_CAPACITY) limits the total number of bubbles
 }
 
@@ -3,13 +3,22 @@
 
 #include <vector>
 #include <random>
-#include "Bubble.h"
+#include "BubbleStore.h"
 #include "Surface2D.h"
 
+// What to do with a new bubble when the pool is full
+enum class SpawnPolicy {
+    Reject,         // Drop the new bubble
+    RecycleOldest,  // Remove the bubble spawned first (lowest id)
+    RecycleHighest  // Remove the bubble closest to the top, the next one to leave anyway
+};
+
+const char* getSpawnPolicyName(SpawnPolicy policy);
+
 // Manages the creation and storage of bubble instances.
 class BubbleGenerator {
 public:
-    std::vector<Bubble> bubbles; // Active bubbles in the simulation
+    BubbleStore bubbles; // Active bubbles in the simulation, capacity fixed at BUBBLE_POOL_CAPACITY
     BubbleGenerator();
 
     // Generate initial set of bubbles
@@ -20,8 +29,21 @@ public:
 
     int getNextBubbleID() { return next_bubble_id++; }
 
+    // Adds the bubble, making room by the spawn policy if the pool is full. False if it was dropped.
+    bool spawnBubble(const Bubble& bubble);
+
+    void setSpawnPolicy(SpawnPolicy policy) { spawn_policy = policy; }
+    SpawnPolicy getSpawnPolicy() const { return spawn_policy; }
+    size_t getRejectedCount() const { return rejected_count; }
+    size_t getRecycledCount() const { return recycled_count; }
+
 private:
     int next_bubble_id; // unique IDs for bubbles
+    SpawnPolicy spawn_policy;
+    size_t rejected_count;
+    size_t recycled_count;
+
+    int findRecycleVictim() const;
 
     // For generation timing/probability
     std::mt19937 random_engine;
@@ -58,7 +58,7 @@ void BubbleRenderer::initRenderData() {
 }
 
 // Renders all bubbles
-void BubbleRenderer::renderBubbles(const std::vector<Bubble>& bubbles) {
+void BubbleRenderer::renderBubbles(const BubbleStore& bubbles, float alpha) {
     this->shader.use(); // Activate the shader program
 
     glActiveTexture(GL_TEXTURE0);
@@ -67,15 +67,19 @@ void BubbleRenderer::renderBubbles(const std::vector<Bubble>& bubbles) {
 
     glBindVertexArray(this->quadVAO); // Bind the quad VAO
 
-    for (const Bubble& bubble : bubbles) {
+    const glm::vec2* positions = bubbles.getPositions();
+    const glm::vec2* previous_positions = bubbles.getPreviousPositions();
+    const float* radii = bubbles.getRadii();
+    for (size_t i = 0; i < bubbles.size(); ++i) {
         // Calculate model matrix for this bubble
         glm::mat4 model = glm::mat4(1.0f); // Start with identity matrix
 
         // 1. Translate to the bubble's position
-        model = glm::translate(model, glm::vec3(bubble.position.x, bubble.position.y, 0.0f));
+        glm::vec2 position = glm::mix(previous_positions[i], positions[i], alpha);
+        model = glm::translate(model, glm::vec3(position.x, position.y, 0.0f));
 
         // 2. Scale the unit quad by the bubble's diameter
-        float diameter = bubble.radius * 2.0f;
+        float diameter = radii[i] * 2.0f;
         model = glm::scale(model, glm::vec3(diameter, diameter, 1.0f));
 
         // Set the model matrix uniform in the shader
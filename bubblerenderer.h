@@ -7,7 +7,7 @@
 #include <glm/glm.hpp>              // For glm::mat4, glm::vec3
 #include <glm/gtc/matrix_transform.hpp> // For glm::translate, glm::scale
 #include "Shader.h" // Your updated Shader class
-#include "Bubble.h"
+#include "BubbleStore.h"
 
 // Renders a collection of bubbles as textured quads.
 class BubbleRenderer {
@@ -20,11 +20,12 @@ public:
     // Destructor to clean up OpenGL resources.
     ~BubbleRenderer();
 
-    // Renders all bubbles in the provided vector.
-    //   bubbles: A vector of Bubble objects to render.
+    // Renders all bubbles in the provided store.
+    //   bubbles: The bubbles to render.
+    //   alpha: Blend from the positions before the last step (0) to the current ones (1).
     //   projection: The orthographic projection matrix.
     //               (The shader should already have this set from main)
-    void renderBubbles(const std::vector<Bubble>& bubbles);
+    void renderBubbles(const BubbleStore& bubbles, float alpha = 1.0f);
 
 private:
     Shader& shader;              // Reference to the shader program.
@@ -1,140 +1,288 @@
 #include "BubbleSimulator.h"
 #include "BubbleGenerator.h" 
+#include "CounterRng.h"
 #include <glm/gtx/norm.hpp> 
 #include <algorithm>
+#include <random>
+#include <thread>
+
+const char* getStepLimitName(StepLimit limit) {
+    switch (limit) {
+    case StepLimit::MaxStep: return "max step";
+    case StepLimit::BubbleMotion: return "bubble motion";
+    case StepLimit::FluidSpeed: return "fluid speed";
+    case StepLimit::ContactStiffness: return "contact stiffness";
+    case StepLimit::MinStep: return "min step";
+    }
+    return "Unknown";
+}
+
+// Different every run unless setSeed is called
+static uint64_t randomSeed() {
+    std::random_device device;
+    uint64_t high = device();
+    return (high << 32) | device();
+}
 
 // Constructor
 BubbleSimulator::BubbleSimulator(int screenWidth, int screenHeight)
-    : fluid_grid(screenWidth, screenHeight),
+    : features(DEFAULT_SIMULATION_FEATURES),
+    fluid_grid(screenWidth, screenHeight),
+    surface_grid(static_cast<float>(screenWidth), static_cast<float>(screenHeight), SURFACE_GRID_CELL_SIZE, BUBBLE_MAX_RADIUS),
+    surface_field(static_cast<float>(screenWidth), static_cast<float>(screenHeight), SURFACE_FIELD_CELL_SIZE, SURFACE_FIELD_BAND),
+    surface_query_mode(SurfaceQueryMode::Segments),
     screen_width(static_cast<float>(screenWidth)),
     screen_height(static_cast<float>(screenHeight)),
-    random_engine(std::random_device{}()), 
-    random_dist(0.0f, 1.0f) {
+    broadphase_mode(BroadphaseMode::SpatialHash),
+    broadphase(createBroadphase(broadphase_mode, screen_width, screen_height)),
+    narrowphase_mode(NarrowphaseMode::Batched),
+    thread_pool(new ThreadPool(static_cast<int>(std::thread::hardware_concurrency()))),
+    integration_mode(IntegrationMode::Explicit),
+    sleeping_enabled(true),
+    sleeping_count(0),
+    multirate_enabled(true),
+    held_count(0),
+    fusion_probability(BUBBLE_FUSION_PROBABILITY),
+    fusion_seed(randomSeed()),
+    step_count(0),
+    last_stable_step(ADAPTIVE_STEP_MAX),
+    last_step_limit(StepLimit::MaxStep) {
 }
 
 void BubbleSimulator::addSurface(const Surface2D& surface) {
+    surface_grid.addSurface(surface, static_cast<int>(surfaces.size()));
+    surface_field.addSurface(surface, static_cast<int>(surfaces.size()));
+    fluid_grid.addSolidSurface(surface);
     surfaces.push_back(surface);
 }
 
-void BubbleSimulator::update(float dt, std::vector<Bubble>& bubbles) {
-    if (dt <= 0.0f) return;
-    fluid_grid.update(dt);
+void BubbleSimulator::setBroadphaseMode(BroadphaseMode mode) {
+    if (mode == broadphase_mode) return;
+    broadphase_mode = mode;
+    broadphase = createBroadphase(mode, screen_width, screen_height);
+}
 
-    //Apply forces to bubbles & update them
-    for (Bubble& bubble : bubbles) {
-        if (bubble.marked_for_removal) continue;
+void BubbleSimulator::setThreadCount(int threadCount) {
+    if (threadCount == thread_pool->getThreadCount()) return;
+    thread_pool.reset(new ThreadPool(threadCount));
+}
 
-        bubble.force_accumulator = glm::vec2(0.0f, 0.0f); // Reset forces
+int BubbleSimulator::getThreadCount() const {
+    return thread_pool->getThreadCount();
+}
 
-        applyGravity(bubble);
-        applyBuoyancy(bubble);
-        applyDrag(bubble);
-        //applyLift(bubble) // needs better vorticity calc
-        // Adhesion forces are handled after surface collision and normal force estimation
+void BubbleSimulator::update(float dt, BubbleStore& bubbles) {
+    if (dt <= 0.0f) return;
+    bubbles.storePreviousPositions();
+    fluid_grid.update(dt);
+    assignLanes(bubbles, dt);
+
+    //Apply forces to bubbles & update them.
+    // The fluid is sampled for every bubble first, then one fused kernel computes gravity, buoyancy
+    // and drag of all awake bubbles.
+    const size_t count = bubbles.size();
+    fluid_samples.resize(count);
+    force_active.resize(count);
+    fluid_grid.getVelocitiesAt(bubbles.getPositions(), count, fluid_samples.data());
+    for (size_t i = 0; i < count; ++i) {
+        BubbleRef bubble = bubbles[i];
+        force_active[i] = 0;
+        if (bubble.marked_for_removal || lane_held[i]) continue;
+
+        if (bubble.sleeping) {
+            // Only a fast enough flow around it wakes it here, touching neighbours are checked with the islands
+            if (!sleeping_enabled ||
+                glm::length2(fluid_samples[i]) > SLEEP_WAKE_FLUID_SPEED * SLEEP_WAKE_FLUID_SPEED) {
+                wakeBubble(bubble);
+            }
+            continue;
+        }
+        force_active[i] = 1;
+    }
+    body_forces.compute(bubbles, fluid_samples.data(), force_active.data());
+    if (features.lift) {
+        for (size_t i = 0; i < count; ++i) {
+            if (force_active[i]) applyLift(bubbles[i], fluid_samples[i]);
+        }
     }
 
     // Handle Collisions
-    handleBubbleCollisions(bubbles);
-    handleSurfaceCollisions(bubbles, dt); 
+    if (integration_mode == IntegrationMode::Xpbd) {
+        solveContactConstraints(bubbles, dt);
+    }
+    else {
+        handleBubbleCollisions(bubbles);
+        handleSurfaceCollisions(bubbles);
+    }
 
-    // Integrate motion for bubbles not stuck by static adhesion
-    for (Bubble& bubble : bubbles) {
-        if (bubble.marked_for_removal) continue;
+    // Integrate motion for bubbles not stuck by static adhesion.
+    // Runs over the store's arrays, only the hot fields are touched.
+    glm::vec2* positions = bubbles.getPositions();
+    glm::vec2* velocities = bubbles.getVelocities();
+    const glm::vec2* forces = bubbles.getForces();
+    const float* radii = bubbles.getRadii();
+    const float* masses = bubbles.getMasses();
+    const uint8_t* sleeping = bubbles.getSleepingFlags();
+    const uint8_t* marked_for_removal = bubbles.getRemovalFlags();
+    // Implicit mode takes the velocity change from the contact solve instead of F / m * dt
+    const glm::vec2* velocity_changes = integration_mode == IntegrationMode::Implicit ? implicit_solver.solve(bubbles, dt) : nullptr;
+    // XPBD mode has already moved every bubble, only the boundaries are left
+    const bool integrated = integration_mode == IntegrationMode::Xpbd;
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        if (marked_for_removal[i] || sleeping[i] || lane_held[i]) continue;
 
-        if (bubble.on_surface) {
-            // If on surface, static adhesion might prevent motion or dynamic adhesion applies
-            // The decision to move or the effect of dynamic adhesion is handled within applyAdhesionForces
-            // For now, assume applyAdhesionForces modifies force_accumulator or directly velocity
+        // Static adhesion already cancelled the tangential force in force_accumulator
+        const float step = lane_dts[i];
+        if (velocity_changes) {
+            velocities[i] += velocity_changes[i];
         }
-
-        // If not fully constrained by static adhesion:
-        glm::vec2 acceleration = bubble.force_accumulator / bubble.mass;
-        bubble.velocity += acceleration * dt;
-        bubble.position += bubble.velocity * dt;
+        else if (!integrated) {
+            glm::vec2 acceleration = forces[i] / masses[i];
+            velocities[i] += acceleration * step;
+        }
+        if (!integrated) positions[i] += velocities[i] * step;
 
         // Boundary check
-        if (bubble.position.x - bubble.radius < 0) {
-            bubble.position.x = bubble.radius;
-            bubble.velocity.x *= -0.5f; // Damping
+        glm::vec2& position = positions[i];
+        glm::vec2& velocity = velocities[i];
+        float radius = radii[i];
+        if (position.x - radius < 0) {
+            position.x = radius;
+            velocity.x *= -0.5f; // Damping
         }
-        else if (bubble.position.x + bubble.radius > screen_width) {
-            bubble.position.x = screen_width - bubble.radius;
-            bubble.velocity.x *= -0.5f;
+        else if (position.x + radius > screen_width) {
+            position.x = screen_width - radius;
+            velocity.x *= -0.5f;
         }
-        if (bubble.position.y - bubble.radius < 0) { // Bottom
-            bubble.position.y = bubble.radius;
-            bubble.velocity.y *= -0.5f;
+        if (position.y - radius < 0) { // Bottom
+            position.y = radius;
+            velocity.y *= -0.5f;
             // Potentially stick to bottom surface or pop
         }
-        else if (bubble.position.y + bubble.radius > screen_height) { // Top
-            bubble.marked_for_removal = true; // Remove bubble when reaches top or out of screen
+        else if (position.y + radius > screen_height) { // Top
+            bubbles.markForRemoval(i); // Remove bubble when reaches top or out of screen
         }
+
+        if (sleeping_enabled) updateQuietSteps(bubbles[i]);
+        updateLane(bubbles[i]);
     }
 
+    if (sleeping_enabled) sleepQuietIslands(bubbles);
+
+    // Sleeping bubbles keep growing, a new contact from that wakes them next step
     growBubbles(bubbles, dt);
 
     // Two-way coupling - Bubbles affect fluid (after their forces are calculated)
-    for (const Bubble& bubble : bubbles) {
-        if (bubble.marked_for_removal) continue;
-        fluid_grid.applyBubbleForce(bubble, dt);
+    if (features.two_way_coupling) {
+        for (size_t i = 0; i < bubbles.size(); ++i) {
+            ConstBubbleRef bubble = bubbles[i];
+            if (bubble.marked_for_removal || bubble.sleeping || lane_held[i]) continue;
+            fluid_grid.applyBubbleForce(bubble, lane_dts[i]);
+        }
     }
 
     cleanupRemovedBubbles(bubbles);
+    step_count++;
 }
 
-void BubbleSimulator::applyGravity(Bubble& bubble) {
-    bubble.force_accumulator += GRAVITY * bubble.mass;
-}
+// CFL-style limits, each the longest dt that keeps one quantity resolved:
+//   bubbles  v dt + a dt^2 / 2 <= cfl * r_min, with the fastest speed and the largest F / m of the last step
+//   fluid    |u| dt <= cfl * GRID_CELL_SIZE
+//   springs  dt <= sqrt(m_min / k), Explicit only (the other modes are stable past it)
+float BubbleSimulator::computeStableStep(const BubbleStore& bubbles) {
+    const glm::vec2* velocities = bubbles.getVelocities();
+    const glm::vec2* forces = bubbles.getForces();
+    const float* radii = bubbles.getRadii();
+    const float* masses = bubbles.getMasses();
+    const uint8_t* sleeping = bubbles.getSleepingFlags();
+    const uint8_t* marked_for_removal = bubbles.getRemovalFlags();
+
+    float max_speed_sq = 0.0f;
+    float max_acceleration_sq = 0.0f;
+    float min_radius = BUBBLE_MAX_RADIUS;
+    float min_mass = Bubble::calculateMass(BUBBLE_MAX_RADIUS);
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        if (marked_for_removal[i] || sleeping[i]) continue;
+        max_speed_sq = glm::max(max_speed_sq, glm::length2(velocities[i]));
+        max_acceleration_sq = glm::max(max_acceleration_sq, glm::length2(forces[i] / masses[i]));
+        min_radius = glm::min(min_radius, radii[i]);
+        min_mass = glm::min(min_mass, masses[i]);
+    }
 
-void BubbleSimulator::applyBuoyancy(Bubble& bubble) {
-    // Buoyancy F_b = (m_bubble - rho_liq * V_bubble) * g_vec  (from paper)
-    // This means buoyant force opposes gravity effectively if m_bubble is small
-    // Or, simpler: Buoyant force = rho_liq * V _bubble * (-g_unit_vec) * |g|
-    // Small bubble mass is negligible compared to displaced water mass.
-    float displaced_fluid_mass = WATER_DENSITY * bubble.getArea();
-    glm::vec2 buoyancy_force = -GRAVITY * displaced_fluid_mass;
-    bubble.force_accumulator += buoyancy_force;
-}
+    float step = ADAPTIVE_STEP_MAX;
+    last_step_limit = StepLimit::MaxStep;
 
-void BubbleSimulator::applyDrag(Bubble& bubble) {
-    // F_d = -k_drag * (m_i / r_i) * |v_rel| * v_rel
-    glm::vec2 fluid_vel_at_bubble = fluid_grid.getVelocityAt(bubble.position);
-    glm::vec2 relative_velocity = bubble.velocity - fluid_vel_at_bubble;
-    float relative_speed_sq = glm::length2(relative_velocity);
+    const float reach = ADAPTIVE_STEP_CFL * min_radius;
+    const float speed = glm::sqrt(max_speed_sq);
+    const float acceleration = glm::sqrt(max_acceleration_sq);
+    float motion_step = step;
+    if (acceleration > 0.0f) {
+        motion_step = (glm::sqrt(speed * speed + 2.0f * acceleration * reach) - speed) / acceleration;
+    }
+    else if (speed > 0.0f) {
+        motion_step = reach / speed;
+    }
+    if (motion_step < step) {
+        step = motion_step;
+        last_step_limit = StepLimit::BubbleMotion;
+    }
 
-    if (relative_speed_sq > 0.000001f) {
-        float relative_speed = glm::sqrt(relative_speed_sq);
+    const float fluid_speed = fluid_grid.getMaxSpeed();
+    if (fluid_speed > 0.0f && ADAPTIVE_STEP_CFL * GRID_CELL_SIZE / fluid_speed < step) {
+        step = ADAPTIVE_STEP_CFL * GRID_CELL_SIZE / fluid_speed;
+        last_step_limit = StepLimit::FluidSpeed;
+    }
 
-        if (bubble.radius > 0.01f) { // Avoid division by zero
-            float paper_factor = bubble.mass / bubble.radius;
-            glm::vec2 drag_force = -FLUID_DRAG_COEFFICIENT * paper_factor * relative_speed * relative_velocity;
-            bubble.force_accumulator += drag_force;
+    if (integration_mode == IntegrationMode::Explicit) {
+        const float spring_step = glm::sqrt(min_mass / BUBBLE_COLLISION_STIFFNESS);
+        if (spring_step < step) {
+            step = spring_step;
+            last_step_limit = StepLimit::ContactStiffness;
         }
     }
+
+    if (step < ADAPTIVE_STEP_MIN) {
+        step = ADAPTIVE_STEP_MIN;
+        last_step_limit = StepLimit::MinStep;
+    }
+    last_stable_step = step;
+    return step;
 }
 
- //void BubbleSimulator::applyLift(Bubble& bubble) {
- //    // F_l = k_lift * m_i * (v_i - u_i) x Omega_i
- //    // Cross product in 2D: (Ax, Ay) x Oz = (Ay*Oz, -Ax*Oz)
- //    glm::vec2 fluid_vel_at_bubble = fluid_grid.getVelocityAt(bubble.position);
- //    glm::vec2 relative_velocity = bubble.velocity - fluid_vel_at_bubble;
- //   float vorticity = fluid_grid.getVorticityAt(bubble.position); // Scalar in 2D
+// Single bubble version of the body force pass, for bubbles that join a step late (woken, released)
+void BubbleSimulator::applyBodyForces(BubbleRef bubble) {
+    glm::vec2 fluid_velocity = fluid_grid.getVelocityAt(bubble.position);
+    bubble.force_accumulator = computeBodyForce(bubble.velocity, fluid_velocity, bubble.radius, bubble.mass);
+    if (features.lift) applyLift(bubble, fluid_velocity);
+    // Adhesion forces are handled after surface collision and normal force estimation
+}
+
+void BubbleSimulator::applyLift(BubbleRef bubble, glm::vec2 fluidVelocity) {
+    // F_l = k_lift * m_i * (v_i - u_i) x Omega_i
+    // Cross product in 2D: (Ax, Ay) x Oz = (Ay*Oz, -Ax*Oz)
+    glm::vec2 relative_velocity = bubble.velocity - fluidVelocity;
+    float vorticity = fluid_grid.getVorticityAt(bubble.position); // Scalar in 2D
 
- //    if (glm::abs(vorticity) > 0.001f) {
- //        glm::vec2 lift_force_dir(relative_velocity.y * vorticity, -relative_velocity.x * vorticity);
- //        bubble.force_accumulator += FLUID_LIFT_COEFFICIENT * bubble.mass * lift_force_dir;
- //    }
- //}
+    if (glm::abs(vorticity) > 0.001f) {
+        glm::vec2 lift_force_dir(relative_velocity.y * vorticity, -relative_velocity.x * vorticity);
+        bubble.force_accumulator += FLUID_LIFT_COEFFICIENT * bubble.mass * lift_force_dir;
+    }
+}
 
 // --- Adhesion ---
 
-float BubbleSimulator::normalForceOnSurface(const Bubble& bubble, const Surface2D& surface, float dt) {
-    // Static term: buoyancy contribution
+// Buoyancy component along the normal, what the bubble presses on the surface with at rest
+float BubbleSimulator::staticNormalForce(ConstBubbleRef bubble, glm::vec2 surface_normal) const {
     glm::vec2 buoyancy_comp = -GRAVITY * (WATER_DENSITY * bubble.getArea());
-    float N_static = glm::abs(glm::dot(buoyancy_comp, surface.normal));
+    return glm::abs(glm::dot(buoyancy_comp, surface_normal));
+}
+
+float BubbleSimulator::normalForceOnSurface(ConstBubbleRef bubble, glm::vec2 surface_normal, float dt) {
+    // Static term: buoyancy contribution
+    float N_static = staticNormalForce(bubble, surface_normal);
 
     // Dynamic term: impact force (if colliding)
-    float velocity_impact = glm::dot(bubble.velocity, surface.normal);
+    float velocity_impact = glm::dot(bubble.velocity, surface_normal);
     float N_dynamic = bubble.mass * glm::max(0.0f, -velocity_impact) / dt;
 
     // Safety threshold
@@ -142,15 +290,16 @@ float BubbleSimulator::normalForceOnSurface(const Bubble& bubble, const Surface2
 }
 
 
-void BubbleSimulator::applyAdhesionForces(Bubble& bubble, float dt) {
-    if (!bubble.on_surface || bubble.surface_id < 0 || bubble.surface_id >= surfaces.size()) {
+// surface_normal is the segment normal, or the distance field gradient when that is used
+void BubbleSimulator::applyAdhesionForces(BubbleRef bubble, glm::vec2 surface_normal, float dt) {
+    if (!bubble.on_surface || bubble.surface_id < 0 || bubble.surface_id >= static_cast<int>(surfaces.size())) {
         return;
     }
     const Surface2D& surface = surfaces[bubble.surface_id];
-    float N = normalForceOnSurface(bubble, surface, dt); // Magnitude of normal force
+    float N = normalForceOnSurface(bubble, surface_normal, dt); // Magnitude of normal force
 
     // Calculate tangential forces (sum of all forces parallel to surface)
-    glm::vec2 surface_tangent = glm::vec2(surface.normal.y, -surface.normal.x); 
+    glm::vec2 surface_tangent = glm::vec2(surface_normal.y, -surface_normal.x); 
     glm::vec2 net_force_on_bubble = bubble.force_accumulator; // All accumulated forces
 
     // Component of net_force_on_bubble trying to move it along the surface
@@ -189,80 +338,208 @@ void BubbleSimulator::applyAdhesionForces(Bubble& bubble, float dt) {
 
 
 // --- Collision Handling ---
-void BubbleSimulator::handleBubbleCollisions(std::vector<Bubble>& bubbles) {
-    for (size_t i = 0; i < bubbles.size(); ++i) {
-        if (bubbles[i].marked_for_removal) continue;
-        for (size_t j = i + 1; j < bubbles.size(); ++j) {
-            if (bubbles[j].marked_for_removal) continue;
-
-            Bubble& b1 = bubbles[i];
-            Bubble& b2 = bubbles[j];
-
-            glm::vec2 delta_pos = b2.position - b1.position;
-            float dist_sq = glm::length2(delta_pos);
-            float sum_radii = b1.radius + b2.radius;
-
-            if (dist_sq < sum_radii * sum_radii && dist_sq > 0.0001f) {
-                // Try fusion first based on probability
-                if (random_dist(random_engine) < BUBBLE_FUSION_PROBABILITY) {
-                    fuseBubbles(b1, b2, bubbles); // b1 becomes the new bubble
-                    continue;
-                }
+void BubbleSimulator::handleBubbleCollisions(BubbleStore& bubbles) {
+    // Broadphase: only candidate pairs reach the narrowphase
+    broadphase->findPairs(bubbles, candidate_pairs);
+    if (held_count > 0) releaseTouchedBubbles(bubbles);
+    if (sleeping_enabled) buildIslands(bubbles);
+
+    contact_manager.beginStep();
+    implicit_solver.clear();
+    if (narrowphase_mode == NarrowphaseMode::Batched) {
+        resolveBatchedPairs(bubbles);
+    }
+    else {
+        // Narrowphase in the same i/j order as a full pairwise loop
+        for (const BubblePair& pair : candidate_pairs) {
+            // Fusion waits for the stage after the pass, so only bubbles removed before it are skipped
+            if (bubbles[pair.a].marked_for_removal || bubbles[pair.b].marked_for_removal) continue;
+            resolveBubblePair(pair, bubbles);
+        }
+    }
+    fuseAcceptedPairs(bubbles);
+    // Pairs not reported this step (separated or fused) end here
+    contact_manager.endStep();
+}
 
-                // Repulsion
-                float dist = glm::sqrt(dist_sq);
-                glm::vec2 normal_ij = delta_pos / dist; // Normal from b1 to b2
-
-                // Penetration depth scalar
-                float penetration = sum_radii - dist;
-                glm::vec2 penetration_vec = normal_ij * penetration;
-
-                // Relative velocity
-                glm::vec2 relative_velocity_ji = b2.velocity - b1.velocity; 
-                float v_n_scalar = glm::dot(relative_velocity_ji, normal_ij); 
-
-                // Spring force (acts to separate them)
-                glm::vec2 spring_force_on_b2 = penetration_vec * BUBBLE_COLLISION_STIFFNESS;
-
-                // Damping force (opposes relative motion in normal direction)
-                // Positive when bubbles separating (pulls them back)
-                // Negative when approaching (pushes them apart)
-                glm::vec2 damping_force_on_b2 = normal_ij * (-BUBBLE_COLLISION_DAMPING * v_n_scalar);
-
-                // Paper F_c = m_i * (k_col * delta_x_vec + k_damp * v_n_vec) (Force on i)
-                // Delta_x_vec for b1 from b2: normal_ji * penetration = -normal_ij * penetration
-                // v_n_vec for b1 from b2: proj(v1-v2, normal_ji)
-                // For b1:
-                glm::vec2 spring_f1 = -normal_ij * penetration * BUBBLE_COLLISION_STIFFNESS;
-                glm::vec2 rel_vel_b1_vs_b2 = b1.velocity - b2.velocity;
-                float v_n_b1 = glm::dot(rel_vel_b1_vs_b2, -normal_ij);
-                glm::vec2 damp_f1 = -normal_ij * (-BUBBLE_COLLISION_DAMPING * v_n_b1);
-
-
-                // Apply forces (scaled by mass as per paper)
-                // Apply forces directly, next step will handle mass.
-                b1.force_accumulator += (spring_f1 + damp_f1);
-                b2.force_accumulator -= (spring_f1 + damp_f1);
-
-                // Simple position correction to avoid prolonged overlap (can make simulation jittery if too aggressive)
-                float correction_factor = 0.5f;
-                glm::vec2 correction_vec = normal_ij * penetration * correction_factor;
-                b1.position -= correction_vec * (b2.mass / (b1.mass + b2.mass)); // Distribute correction by mass
-                b2.position += correction_vec * (b1.mass / (b1.mass + b2.mass));
-            }
+void BubbleSimulator::resolveBubblePair(const BubblePair& pair, BubbleStore& bubbles) {
+    BubbleRef b1 = bubbles[pair.a];
+    BubbleRef b2 = bubbles[pair.b];
+    glm::vec2 delta_pos = b2.position - b1.position;
+    float dist_sq = glm::length2(delta_pos);
+    float sum_radii = b1.radius + b2.radius;
+
+    // Close but not overlapping, keeps an existing contact alive instead of ending it
+    float contact_reach = sum_radii + CONTACT_HYSTERESIS;
+    if (dist_sq >= sum_radii * sum_radii && dist_sq < contact_reach * contact_reach) {
+        float dist = glm::sqrt(dist_sq);
+        contact_manager.reportContact(b1.id, b2.id, delta_pos / dist, sum_radii - dist);
+        return;
+    }
+
+    if (dist_sq < sum_radii * sum_radii && dist_sq > 0.0001f) {
+        // Try fusion first based on probability
+        // Both asleep (or held in the slow lane) means the pair was already resting like this, keep the contact and skip the response
+        if (isFixed(bubbles, pair.a) && isFixed(bubbles, pair.b)) {
+            float dist = glm::sqrt(dist_sq);
+            contact_manager.reportContact(b1.id, b2.id, delta_pos / dist, sum_radii - dist);
+            return;
+        }
+
+        // Fusing pairs get no response, the fusion stage merges them after the pass
+        if (features.fusion && rollFusion(b1, b2)) {
+            fusion_pairs.push_back(pair);
+            return;
+        }
+
+        // Repulsion
+        float dist = glm::sqrt(dist_sq);
+        glm::vec2 normal_ij = delta_pos / dist; // Normal from b1 to b2
+
+        // Penetration depth scalar
+        float penetration = sum_radii - dist;
+        contact_manager.reportContact(b1.id, b2.id, normal_ij, penetration);
+        if (integration_mode == IntegrationMode::Implicit) implicit_solver.addContact(pair.a, pair.b, normal_ij);
+
+        // Paper F_c = m_i * (k_col * delta_x_vec + k_damp * v_n_vec) (Force on i)
+        // Delta_x_vec for b1 from b2: normal_ji * penetration = -normal_ij * penetration
+        // v_n_vec for b1 from b2: proj(v1-v2, normal_ji)
+        // For b1:
+        glm::vec2 spring_f1 = -normal_ij * penetration * BUBBLE_COLLISION_STIFFNESS;
+        glm::vec2 rel_vel_b1_vs_b2 = b1.velocity - b2.velocity;
+        float v_n_b1 = glm::dot(rel_vel_b1_vs_b2, -normal_ij);
+        glm::vec2 damp_f1 = -normal_ij * (-BUBBLE_COLLISION_DAMPING * v_n_b1);
+
+
+        // Apply forces (scaled by mass as per paper)
+        // Apply forces directly, next step will handle mass.
+        // A sleeping bubble still here is part of a still island and acts as fixed, its side is skipped
+        if (!b1.sleeping) b1.force_accumulator += (spring_f1 + damp_f1);
+        if (!b2.sleeping) b2.force_accumulator -= (spring_f1 + damp_f1);
+
+        // Simple position correction to avoid prolonged overlap (can make simulation jittery if too aggressive)
+        float correction_factor = 0.5f;
+        glm::vec2 correction_vec = normal_ij * penetration * correction_factor;
+        if (b1.sleeping) {
+            b2.position += correction_vec;
+        }
+        else if (b2.sleeping) {
+            b1.position -= correction_vec;
+        }
+        else {
+            b1.position -= correction_vec * (b2.mass / (b1.mass + b2.mass)); // Distribute correction by mass
+            b2.position += correction_vec * (b1.mass / (b1.mass + b2.mass));
         }
     }
 }
 
 
-void BubbleSimulator::handleSurfaceCollisions(std::vector<Bubble>& bubbles, float dt) {
-    for (Bubble& bubble : bubbles) {
-        if (bubble.marked_for_removal) continue;
+// Same rules as resolveBubblePair, but every pair's response comes from the state before the pass,
+// so nothing depends on the order pairs are visited in:
+// 1. The kernel writes each pair's deltas into its own slot of pair_deltas, in parallel.
+// 2. A serial pass in pair order reports contacts and collects the pairs that fuse.
+// 3. Each bubble sums the deltas of its own pairs in pair order, in parallel over bubbles.
+// 4. The fusion stage merges the fusing groups.
+// The output is the same for any thread count.
+void BubbleSimulator::resolveBatchedPairs(BubbleStore& bubbles) {
+    narrowphase.computeDeltas(bubbles, candidate_pairs, pair_deltas, thread_pool.get());
+
+    const int bubble_count = static_cast<int>(bubbles.size());
+    pair_fusing.assign(candidate_pairs.size(), 0);
+    for (size_t p = 0; p < candidate_pairs.size(); ++p) {
+        const BubblePair& pair = candidate_pairs[p];
+        BubbleRef b1 = bubbles[pair.a];
+        BubbleRef b2 = bubbles[pair.b];
+        if (b1.marked_for_removal || b2.marked_for_removal) continue;
+
+        float penetration = pair_deltas.penetration[p];
+        glm::vec2 normal_ij(pair_deltas.normal_x[p], pair_deltas.normal_y[p]);
+        if (penetration <= 0.0f) {
+            // Close but not overlapping, keeps an existing contact alive
+            if (penetration > -CONTACT_HYSTERESIS) contact_manager.reportContact(b1.id, b2.id, normal_ij, penetration);
+            continue;
+        }
+        if (features.fusion && !(isFixed(bubbles, pair.a) && isFixed(bubbles, pair.b)) && rollFusion(b1, b2)) {
+            fusion_pairs.push_back(pair);
+            pair_fusing[p] = 1;
+            continue;
+        }
+        contact_manager.reportContact(b1.id, b2.id, normal_ij, penetration);
+        if (integration_mode == IntegrationMode::Implicit && !(b1.sleeping && b2.sleeping)) {
+            implicit_solver.addContact(pair.a, pair.b, normal_ij);
+        }
+    }
+
+    // Overlapping pairs of every bubble, filled in pair order so each list is ascending
+    incident_start.assign(bubble_count + 1, 0);
+    for (size_t p = 0; p < candidate_pairs.size(); ++p) {
+        if (pair_deltas.penetration[p] <= 0.0f || pair_fusing[p]) continue;
+        incident_start[candidate_pairs[p].a + 1]++;
+        incident_start[candidate_pairs[p].b + 1]++;
+    }
+    for (int i = 0; i < bubble_count; ++i) {
+        incident_start[i + 1] += incident_start[i];
+    }
+    incident_pairs.resize(incident_start[bubble_count]);
+    for (size_t p = 0; p < candidate_pairs.size(); ++p) {
+        if (pair_deltas.penetration[p] <= 0.0f || pair_fusing[p]) continue;
+        incident_pairs[incident_start[candidate_pairs[p].a]++] = static_cast<int>(p);
+        incident_pairs[incident_start[candidate_pairs[p].b]++] = static_cast<int>(p);
+    }
+    // Filling advanced every start to the next bubble's start
+    for (int i = bubble_count; i > 0; --i) {
+        incident_start[i] = incident_start[i - 1];
+    }
+    incident_start[0] = 0;
+
+    // Every bubble only writes itself
+    thread_pool->parallelFor(bubble_count, 256, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            applyPairDeltas(bubbles, static_cast<int>(i));
+        }
+    });
+
+    fuseAcceptedPairs(bubbles);
+}
+
+void BubbleSimulator::applyPairDeltas(BubbleStore& bubbles, int index) {
+    BubbleRef bubble = bubbles[index];
+    if (bubble.marked_for_removal || bubble.sleeping || lane_held[index]) return;
+
+    for (int e = incident_start[index]; e < incident_start[index + 1]; ++e) {
+        const int p = incident_pairs[e];
+        const BubblePair& pair = candidate_pairs[p];
+        ConstBubbleRef partner = bubbles[pair.a == index ? pair.b : pair.a];
+        if (partner.marked_for_removal) continue;
+
+        glm::vec2 force(pair_deltas.force_x[p], pair_deltas.force_y[p]);
+        glm::vec2 correction_a(pair_deltas.correction_ax[p], pair_deltas.correction_ay[p]);
+        glm::vec2 correction_b(pair_deltas.correction_bx[p], pair_deltas.correction_by[p]);
+        glm::vec2 own_correction = pair.a == index ? correction_a : correction_b;
+        glm::vec2 other_correction = pair.a == index ? correction_b : correction_a;
+
+        bubble.force_accumulator += pair.a == index ? force : -force;
+        // A sleeping partner stays put, this bubble takes the whole correction
+        bubble.position += partner.sleeping ? own_correction - other_correction : own_correction;
+    }
+}
+
+void BubbleSimulator::handleSurfaceCollisions(BubbleStore& bubbles) {
+    if (surface_query_mode == SurfaceQueryMode::DistanceField) {
+        handleDistanceFieldCollisions(bubbles);
+        return;
+    }
+
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        BubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal || bubble.sleeping || lane_held[i]) continue;
 
         bool was_on_surface = bubble.on_surface;
         bubble.on_surface = false; // Reset, will be set if collision detected
 
-        for (const Surface2D& surface : surfaces) {
+        // Only segments binned near the bubble, in the order they were added
+        for (int surface_index : surface_grid.getCandidates(bubble.position)) {
+            const Surface2D& surface = surfaces[surface_index];
             // Simplified collision with line segment: project bubble center onto line
             glm::vec2 line_vec = surface.end_point - surface.start_point;
             glm::vec2 bubble_to_start = bubble.position - surface.start_point;
@@ -286,6 +563,7 @@ void BubbleSimulator::handleSurfaceCollisions(std::vector<Bubble>& bubbles, floa
             if (dist_to_line_sq < bubble.radius * bubble.radius) { // Collision with surface
                 bubble.on_surface = true;
                 bubble.surface_id = surface.id;
+                bubble.surface_normal = surface.normal;
                 if (!was_on_surface) bubble.time_on_surface = 0.0f;
 
                 // Collision response: project out of surface along surface normal
@@ -307,7 +585,9 @@ void BubbleSimulator::handleSurfaceCollisions(std::vector<Bubble>& bubbles, floa
                     // Potentially treat as no penetration or adjust logic
                 }
 
-                applyAdhesionForces(bubble, dt); // Apply adhesion now that we know it's on this surface
+                // Apply adhesion now that we know it's on this surface
+                if (features.adhesion) applyAdhesionForces(bubble, surface.normal, lane_dts[i]);
+                else bubble.time_on_surface += lane_dts[i];
                 break; // Assume bubble can only be on one surface at a time
             }
         }
@@ -319,9 +599,159 @@ void BubbleSimulator::handleSurfaceCollisions(std::vector<Bubble>& bubbles, floa
 }
 
 
+// Same response as handleSurfaceCollisions, with the nearest surface, distance and normal
+// read from the baked distance field instead of projecting onto segments. The field only knows
+// the nearest surface, so at a corner this resolves that one where the segment path
+// takes the first segment touched; either way one surface per step, the other on the next.
+void BubbleSimulator::handleDistanceFieldCollisions(BubbleStore& bubbles) {
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        BubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal || bubble.sleeping || lane_held[i]) continue;
+
+        bool was_on_surface = bubble.on_surface;
+        bubble.on_surface = false;
+
+        SurfaceSample sample = surface_field.sample(bubble.position);
+        float dist_to_surface = glm::abs(sample.distance);
+
+        if (sample.surface_index >= 0 && dist_to_surface < bubble.radius) {
+            const Surface2D& surface = surfaces[sample.surface_index];
+            bubble.on_surface = true;
+            bubble.surface_id = surface.id;
+            bubble.surface_normal = sample.normal;
+            if (!was_on_surface) bubble.time_on_surface = 0.0f;
+
+            // Negative distance means the center is behind the surface
+            if (sample.distance < 0.0f) {
+                float penetration = bubble.radius - dist_to_surface;
+                bubble.position += sample.normal * penetration;
+
+                float vn = glm::dot(bubble.velocity, sample.normal);
+                if (vn < 0) {
+                    bubble.velocity -= (1.0f + 0.3f) * vn * sample.normal; // 0.3 is restitution
+                }
+            }
+
+            if (features.adhesion) applyAdhesionForces(bubble, sample.normal, lane_dts[i]);
+            else bubble.time_on_surface += lane_dts[i];
+        }
+        if (!bubble.on_surface) {
+            bubble.time_on_surface = 0.0f;
+            bubble.surface_id = -1;
+        }
+    }
+}
+
+
+// --- XPBD Contacts ---
+
+// Pair constraints, contact events and fusion come from the start of step positions, with the same
+// rules as handleBubbleCollisions. The survivors of a fusion are then predicted like any other
+// bubble, surface contacts are found at the predicted positions (or the start ones if those are
+// clear), and everything is projected away.
+void BubbleSimulator::solveContactConstraints(BubbleStore& bubbles, float dt) {
+    broadphase->findPairs(bubbles, candidate_pairs);
+    if (sleeping_enabled) buildIslands(bubbles);
+
+    contact_manager.beginStep();
+    for (const BubblePair& pair : candidate_pairs) {
+        if (bubbles[pair.a].marked_for_removal || bubbles[pair.b].marked_for_removal) continue;
+        addPairConstraint(pair, bubbles, dt);
+    }
+    fuseAcceptedPairs(bubbles);
+    contact_manager.endStep();
+
+    xpbd_solver.predict(bubbles, dt);
+    addSurfaceConstraints(bubbles, dt);
+    xpbd_solver.solve(bubbles, dt);
+}
+
+// A candidate pair becomes a constraint if it can close its gap during the step, so one that only
+// starts to overlap while the constraints are projected is still kept apart
+void BubbleSimulator::addPairConstraint(const BubblePair& pair, BubbleStore& bubbles, float dt) {
+    ConstBubbleRef b1 = bubbles[pair.a];
+    ConstBubbleRef b2 = bubbles[pair.b];
+    glm::vec2 delta_pos = b2.position - b1.position;
+    float dist_sq = glm::length2(delta_pos);
+    float sum_radii = b1.radius + b2.radius;
+    bool both_sleeping = b1.sleeping && b2.sleeping;
+
+    if (dist_sq < sum_radii * sum_radii && dist_sq > 0.0001f && !both_sleeping && features.fusion && rollFusion(b1, b2)) {
+        fusion_pairs.push_back(pair);
+        return;
+    }
+
+    float contact_reach = sum_radii + CONTACT_HYSTERESIS;
+    if (dist_sq < contact_reach * contact_reach && dist_sq > 0.0001f) {
+        float dist = glm::sqrt(dist_sq);
+        contact_manager.reportContact(b1.id, b2.id, delta_pos / dist, sum_radii - dist);
+    }
+    if (both_sleeping) return;
+    // The velocities have not had this step's forces yet, the margin covers those
+    float reach = sum_radii + (glm::length(b1.velocity) + glm::length(b2.velocity)) * dt + BROADPHASE_MARGIN;
+    if (dist_sq < reach * reach) xpbd_solver.addPair(pair.a, pair.b);
+}
+
+// Same detection as handleSurfaceCollisions and handleDistanceFieldCollisions, at the predicted
+// position and, if that is clear, at the start position: a bubble that was touching keeps its
+// contact even if the prediction carried it off or past a thin surface.
+void BubbleSimulator::addSurfaceConstraints(BubbleStore& bubbles, float dt) {
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        BubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal || bubble.sleeping) continue;
+
+        bool was_on_surface = bubble.on_surface;
+        bubble.on_surface = false;
+
+        const glm::vec2 probes[2] = { bubble.position, xpbd_solver.getStartPosition(static_cast<int>(i)) };
+        for (int p = 0; p < 2 && !bubble.on_surface; ++p) {
+            const glm::vec2 position = probes[p];
+            if (surface_query_mode == SurfaceQueryMode::DistanceField) {
+                SurfaceSample sample = surface_field.sample(position);
+                if (sample.surface_index >= 0 && glm::abs(sample.distance) < bubble.radius) {
+                    glm::vec2 point = position - sample.distance * sample.normal;
+                    addSurfaceConstraint(bubbles, static_cast<int>(i), sample.surface_index, point, sample.normal, was_on_surface, dt);
+                }
+                continue;
+            }
+            for (int surface_index : surface_grid.getCandidates(position)) {
+                const Surface2D& surface = surfaces[surface_index];
+                glm::vec2 line_vec = surface.end_point - surface.start_point;
+                float t = glm::dot(position - surface.start_point, line_vec) / glm::dot(line_vec, line_vec);
+                glm::vec2 point = surface.start_point + glm::clamp(t, 0.0f, 1.0f) * line_vec;
+
+                if (glm::length2(position - point) < bubble.radius * bubble.radius) {
+                    addSurfaceConstraint(bubbles, static_cast<int>(i), surface_index, point, surface.normal, was_on_surface, dt);
+                    break; // One surface at a time, as in handleSurfaceCollisions
+                }
+            }
+        }
+
+        if (!bubble.on_surface) {
+            bubble.time_on_surface = 0.0f;
+            bubble.surface_id = -1;
+        }
+    }
+}
+
+// Adhesion becomes the friction of the contact, with the surface's coefficients, no friction without adhesion
+void BubbleSimulator::addSurfaceConstraint(BubbleStore& bubbles, int index, int surfaceIndex, glm::vec2 point,
+    glm::vec2 normal, bool wasOnSurface, float dt) {
+    BubbleRef bubble = bubbles[index];
+    const Surface2D& surface = surfaces[surfaceIndex];
+    bubble.on_surface = true;
+    bubble.surface_id = surface.id;
+    bubble.surface_normal = normal;
+    bubble.time_on_surface = (wasOnSurface ? bubble.time_on_surface : 0.0f) + dt;
+
+    xpbd_solver.addSurface(index, point, normal, staticNormalForce(bubble, normal),
+        features.adhesion ? surface.static_adhesion : 0.0f, features.adhesion ? surface.dynamic_adhesion : 0.0f);
+}
+
 // --- Other Processes ---
-void BubbleSimulator::growBubbles(std::vector<Bubble>& bubbles, float dt) {
-    for (Bubble& bubble : bubbles) {
+void BubbleSimulator::growBubbles(BubbleStore& bubbles, float dt) {
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        BubbleRef bubble = bubbles[i];
         if (bubble.marked_for_removal) continue;
 
         // Paper: "keeps growing by absorbing the resolved gas in the amount proportional to its surface area."
@@ -335,32 +765,271 @@ void BubbleSimulator::growBubbles(std::vector<Bubble>& bubbles, float dt) {
     }
 }
 
-void BubbleSimulator::fuseBubbles(Bubble& b1, Bubble& b2, std::vector<Bubble>& bubbles) {
-    // b1 absorbs b2. b2 will be marked for removal.
-    float area1 = b1.getArea();
-    float area2 = b2.getArea();
-    float total_area = area1 + area2;
+// Same answer for a pair within a step wherever and whenever it is asked
+bool BubbleSimulator::rollFusion(ConstBubbleRef b1, ConstBubbleRef b2) const {
+    return counterUniform(fusion_seed, step_count, b1.id, b2.id) < fusion_probability;
+}
+
+int BubbleSimulator::findFusionRoot(int index) {
+    while (fusion_parent[index] != index) {
+        fusion_parent[index] = fusion_parent[fusion_parent[index]]; // Path halving
+        index = fusion_parent[index];
+    }
+    return index;
+}
+
+// Fusion stage. Accepted pairs are joined into groups with union-find, so chains (A+B and B+C in
+// the same step) become one bubble whatever order the pairs were found in. Each group is merged
+// into its lowest-index bubble in one go; groups are independent and run on the thread pool.
+void BubbleSimulator::fuseAcceptedPairs(BubbleStore& bubbles) {
+    if (fusion_pairs.empty()) return;
+
+    // Union by lowest index, so the root is the bubble that survives
+    fusion_parent.resize(bubbles.size());
+    for (const BubblePair& pair : fusion_pairs) {
+        fusion_parent[pair.a] = pair.a;
+        fusion_parent[pair.b] = pair.b;
+    }
+    for (const BubblePair& pair : fusion_pairs) {
+        int root_a = findFusionRoot(pair.a);
+        int root_b = findFusionRoot(pair.b);
+        if (root_a < root_b) fusion_parent[root_b] = root_a;
+        else if (root_b < root_a) fusion_parent[root_a] = root_b;
+    }
+
+    // Members grouped by root, each group in index order
+    fusion_members.clear();
+    for (const BubblePair& pair : fusion_pairs) {
+        fusion_members.push_back(std::make_pair(0, pair.a));
+        fusion_members.push_back(std::make_pair(0, pair.b));
+    }
+    for (std::pair<int, int>& member : fusion_members) {
+        member.first = findFusionRoot(member.second);
+    }
+    std::sort(fusion_members.begin(), fusion_members.end());
+    fusion_members.erase(std::unique(fusion_members.begin(), fusion_members.end()), fusion_members.end());
+
+    fusion_groups.clear();
+    for (size_t m = 0; m < fusion_members.size(); ++m) {
+        if (m == 0 || fusion_members[m].first != fusion_members[m - 1].first) fusion_groups.push_back(m);
+    }
+    fusion_groups.push_back(fusion_members.size());
+
+    // Sleeping members wake first, waking updates the shared sleeping count
+    for (const std::pair<int, int>& member : fusion_members) {
+        wakeBubble(bubbles[member.second]);
+    }
+    thread_pool->parallelFor(fusion_groups.size() - 1, 64, [&](size_t begin, size_t end) {
+        for (size_t g = begin; g < end; ++g) {
+            mergeFusionGroup(bubbles, fusion_groups[g], fusion_groups[g + 1]);
+        }
+    });
+    // Every member but the root was merged into it
+    for (const std::pair<int, int>& member : fusion_members) {
+        if (member.second != member.first) bubbles.markForRemoval(member.second);
+    }
+    fusion_pairs.clear();
+
+    // Radii jumped and bubbles are gone, cached broadphase state is out of date
+    broadphase->invalidate();
+}
+
+// Merges fusion_members[begin, end) into the first of them. Area, momentum and the
+// mass-weighted centroid are kept, forces already gathered this step are summed.
+// The caller marks the other members for removal.
+void BubbleSimulator::mergeFusionGroup(BubbleStore& bubbles, size_t begin, size_t end) {
+    BubbleRef survivor = bubbles[fusion_members[begin].second];
+    float total_area = 0.0f;
+    float total_mass = 0.0f;
+    glm::vec2 weighted_position(0.0f);
+    glm::vec2 momentum(0.0f);
+    glm::vec2 total_force(0.0f);
+    for (size_t m = begin; m < end; ++m) {
+        ConstBubbleRef member = bubbles[fusion_members[m].second];
+        total_area += member.getArea();
+        total_mass += member.mass;
+        weighted_position += member.position * member.mass;
+        momentum += member.velocity * member.mass;
+        total_force += member.force_accumulator;
+    }
+
+    survivor.position = weighted_position / total_mass;
+    survivor.velocity = momentum / total_mass;
+    survivor.force_accumulator = total_force;
+    survivor.radius = glm::sqrt(total_area / glm::pi<float>()); // New radius from total area
+    survivor.updateMass();
+
+    // Cap radius after fusion, the only place area is not kept
+    if (survivor.radius > BUBBLE_MAX_RADIUS) {
+        survivor.radius = BUBBLE_MAX_RADIUS;
+        survivor.updateMass();
+    }
+}
+
+// --- Sleeping ---
+int BubbleSimulator::findIsland(int index) {
+    while (island_parent[index] != index) {
+        island_parent[index] = island_parent[island_parent[index]]; // Path halving
+        index = island_parent[index];
+    }
+    return index;
+}
+
+void BubbleSimulator::wakeBubble(BubbleRef bubble) {
+    if (!bubble.sleeping) return;
+    bubble.sleeping = false;
+    bubble.quiet_steps = 0;
+    if (sleeping_count > 0) sleeping_count--;
+    applyBodyForces(bubble); // It was skipped by this step's force pass
+}
+
+// Groups bubbles into islands of overlapping pairs and wakes every sleeping island that
+// touches a moving bubble or whose contacts changed since it fell asleep (growth, removals).
+void BubbleSimulator::buildIslands(BubbleStore& bubbles) {
+    const int bubble_count = static_cast<int>(bubbles.size());
+    island_parent.resize(bubble_count);
+    for (int i = 0; i < bubble_count; ++i) island_parent[i] = i;
+    contact_counts.assign(bubble_count, 0);
+
+    for (const BubblePair& pair : candidate_pairs) {
+        ConstBubbleRef b1 = bubbles[pair.a];
+        ConstBubbleRef b2 = bubbles[pair.b];
+        if (b1.marked_for_removal || b2.marked_for_removal) continue;
+        float sum_radii = b1.radius + b2.radius;
+        if (glm::length2(b2.position - b1.position) >= sum_radii * sum_radii) continue;
+
+        contact_counts[pair.a]++;
+        contact_counts[pair.b]++;
+        int root_a = findIsland(pair.a);
+        int root_b = findIsland(pair.b);
+        if (root_a != root_b) island_parent[root_b] = root_a;
+    }
+
+    if (sleeping_count == 0) return;
+
+    // Flag islands that have to wake
+    island_flags.assign(bubble_count, 0);
+    for (int i = 0; i < bubble_count; ++i) {
+        ConstBubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal) continue;
+        bool moving = !bubble.sleeping && bubble.quiet_steps == 0;
+        bool contacts_changed = bubble.sleeping && contact_counts[i] != bubble.sleep_contacts;
+        if (moving || contacts_changed) island_flags[findIsland(i)] = 1;
+    }
+    for (int i = 0; i < bubble_count; ++i) {
+        if (bubbles[i].sleeping && island_flags[findIsland(i)]) wakeBubble(bubbles[i]);
+    }
+}
+
+// Counts the steps a bubble rests on a surface: not sliding, not leaving it and with no net force along it.
+// Motion into the surface is allowed, the surface holds that back.
+void BubbleSimulator::updateQuietSteps(BubbleRef bubble) {
+    bool quiet = false;
+    if (bubble.on_surface) {
+        glm::vec2 surface_tangent(bubble.surface_normal.y, -bubble.surface_normal.x);
+        float tangential_speed = glm::dot(bubble.velocity, surface_tangent);
+        float separating_speed = glm::dot(bubble.velocity, bubble.surface_normal);
+        float tangential_force = glm::dot(bubble.force_accumulator, surface_tangent);
+        quiet = glm::abs(tangential_speed) < SLEEP_VELOCITY_THRESHOLD &&
+            separating_speed < SLEEP_VELOCITY_THRESHOLD &&
+            glm::abs(tangential_force) < SLEEP_ACCELERATION_THRESHOLD * bubble.mass;
+    }
+    bubble.quiet_steps = quiet ? bubble.quiet_steps + 1 : 0;
+}
+
+// Puts islands to sleep once every member has been quiet for SLEEP_STEPS, islands are the ones
+// built at the start of this step's collision pass
+void BubbleSimulator::sleepQuietIslands(BubbleStore& bubbles) {
+    const int bubble_count = static_cast<int>(bubbles.size());
+    island_flags.assign(bubble_count, 1);
+    for (int i = 0; i < bubble_count; ++i) {
+        ConstBubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal || bubble.sleeping) continue;
+        if (bubble.quiet_steps < SLEEP_STEPS) island_flags[findIsland(i)] = 0;
+    }
+    sleeping_count = 0;
+    for (int i = 0; i < bubble_count; ++i) {
+        BubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal) continue;
+        if (!bubble.sleeping && island_flags[findIsland(i)]) {
+            bubble.sleeping = true;
+            bubble.velocity = glm::vec2(0.0f);
+            bubble.sleep_contacts = contact_counts[i];
+        }
+        if (bubble.sleeping) sleeping_count++;
+    }
+}
+
+// --- Multi-rate ---
 
-    // Centroid for new position (weighted by area/mass)
-    b1.position = (b1.position * b1.mass + b2.position * b2.mass) / (b1.mass + b2.mass);
-    // Conserve momentum
-    b1.velocity = (b1.velocity * b1.mass + b2.velocity * b2.mass) / (b1.mass + b2.mass);
+// Every bubble gathers dt. Slow-lane bubbles are held until their turn, which comes every
+// MULTIRATE_INTERVAL steps for all of them at once, so two touching slow bubbles are always
+// held or advanced together. Everything else is advanced by all the time it gathered, dt unless it was held before.
+void BubbleSimulator::assignLanes(BubbleStore& bubbles, float dt) {
+    const bool lanes = multirate_enabled && integration_mode == IntegrationMode::Explicit;
+    lane_held.assign(bubbles.size(), 0);
+    lane_dts.assign(bubbles.size(), dt);
+    held_count = 0;
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        BubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal || bubble.sleeping) {
+            bubble.lane_time = 0.0f; // Still anyway, nothing to catch up on
+            continue;
+        }
 
-    b1.radius = glm::sqrt(total_area / glm::pi<float>()); // New radius from total area
-    b1.updateMass(); // Update mass for new radius
+        bubble.lane_time += dt;
+        bool turn = step_count % MULTIRATE_INTERVAL == 0;
+        if (lanes && bubble.slow_lane && !turn) {
+            lane_held[i] = 1;
+            held_count++;
+            continue;
+        }
+        lane_dts[i] = bubble.lane_time;
+        bubble.lane_time = 0.0f;
+    }
+}
+
+// A held bubble overlapping a bubble that moves this step was hit and takes part in the step.
+// Held and sleeping neighbours stay as they are, the pair pass leaves two fixed bubbles alone.
+void BubbleSimulator::releaseTouchedBubbles(BubbleStore& bubbles) {
+    for (const BubblePair& pair : candidate_pairs) {
+        if (isFixed(bubbles, pair.a) == isFixed(bubbles, pair.b)) continue;
+        ConstBubbleRef b1 = bubbles[pair.a];
+        ConstBubbleRef b2 = bubbles[pair.b];
+        if (b1.marked_for_removal || b2.marked_for_removal) continue;
+        if (b1.sleeping || b2.sleeping) continue; // A sleeping partner, buildIslands decides
+
+        float sum_radii = b1.radius + b2.radius;
+        if (glm::length2(b2.position - b1.position) >= sum_radii * sum_radii) continue;
+        if (lane_held[pair.a]) releaseBubble(bubbles, pair.a);
+        if (lane_held[pair.b]) releaseBubble(bubbles, pair.b);
+    }
+}
+
+// Back to the fast lane, catching up on the time it was held for in this step
+void BubbleSimulator::releaseBubble(BubbleStore& bubbles, int index) {
+    BubbleRef bubble = bubbles[index];
+    lane_held[index] = 0;
+    held_count--;
+    lane_dts[index] = bubble.lane_time;
+    bubble.lane_time = 0.0f;
+    bubble.slow_lane = false;
+    applyBodyForces(bubble); // It was skipped by this step's force pass
+}
 
-    // Cap radius after fusion
-    if (b1.radius > BUBBLE_MAX_RADIUS) {
-        b1.radius = BUBBLE_MAX_RADIUS;
-        b1.updateMass();
+// Decided after each update, so a bubble that detached or started sliding leaves the slow lane right away.
+// Like updateQuietSteps, motion into the surface doesn't count, the surface holds that back.
+void BubbleSimulator::updateLane(BubbleRef bubble) {
+    bool slow = false;
+    if (multirate_enabled && integration_mode == IntegrationMode::Explicit && bubble.on_surface) {
+        glm::vec2 surface_tangent(bubble.surface_normal.y, -bubble.surface_normal.x);
+        slow = glm::abs(glm::dot(bubble.velocity, surface_tangent)) < MULTIRATE_SPEED_THRESHOLD &&
+            glm::dot(bubble.velocity, bubble.surface_normal) < MULTIRATE_SPEED_THRESHOLD;
     }
-    b2.marked_for_removal = true;
+    bubble.slow_lane = slow;
 }
 
-void BubbleSimulator::cleanupRemovedBubbles(std::vector<Bubble>& bubbles) {
-    bubbles.erase(
-        std::remove_if(bubbles.begin(), bubbles.end(), [](const Bubble& b) { return b.marked_for_removal; }),
-        bubbles.end()
-    );
+void BubbleSimulator::cleanupRemovedBubbles(BubbleStore& bubbles) {
+    bubbles.removeMarked();
 }
 
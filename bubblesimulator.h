@@ -2,53 +2,219 @@
 #define BUBBLE_SIMULATOR_H
 
 #include <vector>
-#include <random>
-#include "Bubble.h"
+#include <memory>
+#include <cstdint>
+#include "BubbleStore.h"
 #include "Surface2D.h"
 #include "FluidGrid2D.h"
+#include "Broadphase.h"
+#include "ContactManager.h"
+#include "Narrowphase.h"
+#include "BodyForces.h"
+#include "ImplicitContactSolver.h"
+#include "XpbdContactSolver.h"
+#include "SurfaceGrid.h"
+#include "SurfaceDistanceField.h"
+#include "SimulationConfig.h"
 #include "SimulationConstants.h"
 
 class BubbleGenerator;
 
+// How bubble-surface contacts are found.
+enum class SurfaceQueryMode {
+    Segments,      // Exact closest point on the binned segments, the first one touched in the order they were added
+    DistanceField  // Bilinear lookup in the baked signed distance field, constant cost, the nearest surface
+};
+// Where a bubble touches two surfaces at once (a corner) the two modes can pick a different one.
+
+// What set the step size chosen by computeStableStep.
+enum class StepLimit {
+    MaxStep,         // Nothing moving fast, ADAPTIVE_STEP_MAX
+    BubbleMotion,    // Fastest bubble would cross ADAPTIVE_STEP_CFL of the smallest radius
+    FluidSpeed,      // Fastest fluid cell would cross ADAPTIVE_STEP_CFL of a grid cell
+    ContactStiffness, // Explicit contact springs of the lightest bubble
+    MinStep          // Clamped to ADAPTIVE_STEP_MIN
+};
+
+const char* getStepLimitName(StepLimit limit);
+
 class BubbleSimulator {
 public:
     BubbleSimulator(int screenWidth, int screenHeight);
 
-    void update(float dt, std::vector<Bubble>& bubbles);
+    void update(float dt, BubbleStore& bubbles);
+
+    // Features of the step, DEFAULT_SIMULATION_FEATURES to start with
+    void setFeatures(const SimulationFeatures& enabled) { features = enabled; }
+    const SimulationFeatures& getFeatures() const { return features; }
+
+    // Largest dt the current state allows, between ADAPTIVE_STEP_MIN and ADAPTIVE_STEP_MAX.
+    // Fast bubbles, small bubbles and fast fluid all shorten it; a calm scene gets the longest step.
+    float computeStableStep(const BubbleStore& bubbles);
+    float getLastStableStep() const { return last_stable_step; }
+    StepLimit getLastStepLimit() const { return last_step_limit; }
 
     void addSurface(const Surface2D& surface);
     const std::vector<Surface2D>& getSurfaces() const { return surfaces; }
 
+    void setSurfaceQueryMode(SurfaceQueryMode mode) { surface_query_mode = mode; }
+    SurfaceQueryMode getSurfaceQueryMode() const { return surface_query_mode; }
+    const SurfaceDistanceField& getSurfaceDistanceField() const { return surface_field; }
+
     FluidGrid2D& getFluidGrid() { return fluid_grid; }
 
+    // Broadphase used to find bubble-bubble candidate pairs
+    void setBroadphaseMode(BroadphaseMode mode);
+    BroadphaseMode getBroadphaseMode() const { return broadphase_mode; }
+    // Active broadphase, e.g. the AabbTree for point and radius queries
+    const Broadphase& getBroadphase() const { return *broadphase; }
+
+    // How candidate pairs are resolved, Batched (the default) runs the SIMD kernel of getNarrowphase().
+    // Sequential is the original in-place pass, kept for comparison.
+    void setNarrowphaseMode(NarrowphaseMode mode) { narrowphase_mode = mode; }
+    NarrowphaseMode getNarrowphaseMode() const { return narrowphase_mode; }
+    Narrowphase& getNarrowphase() { return narrowphase; }
+    // Fused gravity, buoyancy and drag kernel of the force pass
+    BodyForces& getBodyForces() { return body_forces; }
+    // Threads for the Batched narrowphase, its results don't depend on the count
+    void setThreadCount(int threadCount);
+    int getThreadCount() const;
+
+    // Explicit or implicit contact springs, or XPBD contact constraints. Implicit stays stable at several
+    // times larger dt, XPBD at any dt for a fixed number of iterations
+    void setIntegrationMode(IntegrationMode mode) { integration_mode = mode; }
+    IntegrationMode getIntegrationMode() const { return integration_mode; }
+    ImplicitContactSolver& getImplicitSolver() { return implicit_solver; }
+    XpbdContactSolver& getXpbdSolver() { return xpbd_solver; }
+
+    // Chance per step that an overlapping pair fuses, BUBBLE_FUSION_PROBABILITY by default
+    void setFusionProbability(float probability) { fusion_probability = probability; }
+    float getFusionProbability() const { return fusion_probability; }
+
+    // Seed of the fusion rolls, a fixed seed makes runs repeatable for any thread count or pair order
+    void setSeed(uint64_t seed) { fusion_seed = seed; }
+    uint64_t getSeed() const { return fusion_seed; }
+
+    // Bubble-bubble contacts kept across steps, with begin/persist/end events of the last step
+    const ContactManager& getContactManager() const { return contact_manager; }
+
+    // Contact islands held still on surfaces fall asleep and are skipped until something wakes them
+    void setSleepingEnabled(bool enabled) { sleeping_enabled = enabled; }
+    bool isSleepingEnabled() const { return sleeping_enabled; }
+    size_t getSleepingCount() const { return sleeping_count; }
+
+    // Slow, surface-attached bubbles are only advanced every MULTIRATE_INTERVAL steps, by the time
+    // gathered since their last update. Touching any bubble puts one straight back in the fast lane.
+    // Explicit mode only, the Implicit and XPBD solvers advance every bubble by the same dt.
+    void setMultirateEnabled(bool enabled) { multirate_enabled = enabled; }
+    bool isMultirateEnabled() const { return multirate_enabled; }
+    size_t getHeldCount() const { return held_count; } // Slow-lane bubbles the last step skipped
+
 private:
     // Force Calculation
-    void applyGravity(Bubble& bubble);
-    void applyBuoyancy(Bubble& bubble);
-    void applyDrag(Bubble& bubble);
-    void applyAdhesionForces(Bubble& bubble, float dt);
+    void applyBodyForces(BubbleRef bubble);
+    void applyLift(BubbleRef bubble, glm::vec2 fluidVelocity);
+    void applyAdhesionForces(BubbleRef bubble, glm::vec2 surface_normal, float dt);
 
     // Collision Handling
-    void handleBubbleCollisions(std::vector<Bubble>& bubbles);
-    void handleSurfaceCollisions(std::vector<Bubble>& bubbles, float dt);
+    void handleBubbleCollisions(BubbleStore& bubbles);
+    void resolveBubblePair(const BubblePair& pair, BubbleStore& bubbles);
+    void resolveBatchedPairs(BubbleStore& bubbles);
+    void applyPairDeltas(BubbleStore& bubbles, int index);
+    void handleSurfaceCollisions(BubbleStore& bubbles);
+    void handleDistanceFieldCollisions(BubbleStore& bubbles);
+
+    // XPBD mode, replaces the two handlers above and the integration
+    void solveContactConstraints(BubbleStore& bubbles, float dt);
+    void addPairConstraint(const BubblePair& pair, BubbleStore& bubbles, float dt);
+    void addSurfaceConstraints(BubbleStore& bubbles, float dt);
+    void addSurfaceConstraint(BubbleStore& bubbles, int index, int surfaceIndex, glm::vec2 point, glm::vec2 normal, bool wasOnSurface, float dt);
 
     // Other Bubble Processes
-    void growBubbles(std::vector<Bubble>& bubbles, float dt);
-    void fuseBubbles(Bubble& b1, Bubble& b2, std::vector<Bubble>& bubbles);
-    void cleanupRemovedBubbles(std::vector<Bubble>& bubbles);
+    void growBubbles(BubbleStore& bubbles, float dt);
+    void fuseAcceptedPairs(BubbleStore& bubbles);
+    void mergeFusionGroup(BubbleStore& bubbles, size_t begin, size_t end);
+    int findFusionRoot(int index);
+    void cleanupRemovedBubbles(BubbleStore& bubbles);
+
+    // Sleeping
+    void buildIslands(BubbleStore& bubbles);
+    void sleepQuietIslands(BubbleStore& bubbles);
+    void updateQuietSteps(BubbleRef bubble);
+    void wakeBubble(BubbleRef bubble);
+    int findIsland(int index);
+
+    // Multi-rate
+    void assignLanes(BubbleStore& bubbles, float dt);
+    void releaseTouchedBubbles(BubbleStore& bubbles);
+    void releaseBubble(BubbleStore& bubbles, int index);
+    void updateLane(BubbleRef bubble);
+    // Asleep or held, stays where it is this step
+    bool isFixed(const BubbleStore& bubbles, int index) const { return bubbles[index].sleeping || lane_held[index]; }
 
     // Simulation State
+    SimulationFeatures features;
     FluidGrid2D fluid_grid;
     std::vector<Surface2D> surfaces;
+    SurfaceGrid surface_grid; // Segment binning, filled by addSurface
+    SurfaceDistanceField surface_field; // Baked incrementally by addSurface
+    SurfaceQueryMode surface_query_mode;
     float screen_width;
     float screen_height;
 
-    // Random number generation
-    std::mt19937 random_engine;
-    std::uniform_real_distribution<float> random_dist;
+    // Broadphase for bubble-bubble collisions
+    BroadphaseMode broadphase_mode;
+    std::unique_ptr<Broadphase> broadphase;
+    std::vector<BubblePair> candidate_pairs;
+
+    BodyForces body_forces;
+    std::vector<glm::vec2> fluid_samples; // Per bubble, fluid velocity at its position this step
+    std::vector<uint8_t> force_active;    // Per bubble, 1 if the body force pass computes its force
+
+    NarrowphaseMode narrowphase_mode;
+    Narrowphase narrowphase;
+    PairDeltas pair_deltas;
+    std::vector<char> pair_fusing;     // Per candidate pair, Batched mode gives fusing pairs no response
+    std::vector<int> incident_start;   // Pairs of bubble i are incident_pairs[incident_start[i] .. incident_start[i + 1])
+    std::vector<int> incident_pairs;   // Pair indices, ascending for every bubble
+    std::unique_ptr<ThreadPool> thread_pool;
+
+    IntegrationMode integration_mode;
+    ImplicitContactSolver implicit_solver; // Gets every pair with a spring response when Implicit
+    XpbdContactSolver xpbd_solver;         // Gets every candidate pair and surface contact when Xpbd
+
+    // Fusion stage, run after the pair pass
+    std::vector<BubblePair> fusion_pairs;  // Overlapping pairs whose fusion roll passed this step
+    std::vector<int> fusion_parent;        // Union-find over bubble indices, the root is the lowest index
+    std::vector<std::pair<int, int>> fusion_members; // (root, index) of every fusing bubble, sorted
+    std::vector<size_t> fusion_groups;     // Start of every root's run in fusion_members, plus the end
+    ContactManager contact_manager;
+
+    // Contact islands, rebuilt every step from the overlapping candidate pairs
+    bool sleeping_enabled;
+    size_t sleeping_count;
+    std::vector<int> island_parent;  // Union-find over bubble indices
+    std::vector<int> contact_counts; // Overlapping neighbours per bubble this step
+    std::vector<char> island_flags;  // Per island root, scratch for the wake and sleep passes
+
+    // Lanes of the current step
+    bool multirate_enabled;
+    size_t held_count;
+    std::vector<char> lane_held;  // Per bubble, slow-lane bubbles waiting for their turn, skipped by every pass
+    std::vector<float> lane_dts;  // Per bubble, the time this step advances it by
+
+    // Fusion rolls come from a counter-based generator keyed by (seed, step, id, id)
+    float fusion_probability;
+    uint64_t fusion_seed;
+    uint64_t step_count;
+
+    float last_stable_step;
+    StepLimit last_step_limit;
+    bool rollFusion(ConstBubbleRef b1, ConstBubbleRef b2) const;
 
     // For adhesion, we need normal force from surface.
-    float normalForceOnSurface(const Bubble& bubble, const Surface2D& surface, float dt);
+    float normalForceOnSurface(ConstBubbleRef bubble, glm::vec2 surface_normal, float dt);
+    float staticNormalForce(ConstBubbleRef bubble, glm::vec2 surface_normal) const;
 };
 
 #endif
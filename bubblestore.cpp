@@ -0,0 +1,172 @@
+#include "BubbleStore.h"
+#include <algorithm>
+#include <functional>
+
+void BubbleStore::reserve(size_t count) {
+    positions.reserve(count);
+    velocities.reserve(count);
+    forces.reserve(count);
+    radii.reserve(count);
+    masses.reserve(count);
+    sleeping.reserve(count);
+    marked_for_removal.reserve(count);
+    ids.reserve(count);
+    on_surface.reserve(count);
+    surface_ids.reserve(count);
+    times_on_surface.reserve(count);
+    surface_normals.reserve(count);
+    previous_positions.reserve(count);
+    quiet_steps.reserve(count);
+    sleep_contacts.reserve(count);
+    slow_lane.reserve(count);
+    lane_times.reserve(count);
+    slot_of.reserve(count);
+    slots.reserve(count);
+    free_slots.reserve(count);
+    pending_removal.reserve(count);
+}
+
+void BubbleStore::setCapacity(size_t maxBubbles) {
+    capacity = maxBubbles;
+    reserve(maxBubbles);
+}
+
+void BubbleStore::clear() {
+    positions.clear();
+    velocities.clear();
+    forces.clear();
+    radii.clear();
+    masses.clear();
+    sleeping.clear();
+    marked_for_removal.clear();
+    ids.clear();
+    on_surface.clear();
+    surface_ids.clear();
+    times_on_surface.clear();
+    surface_normals.clear();
+    previous_positions.clear();
+    quiet_steps.clear();
+    sleep_contacts.clear();
+    slow_lane.clear();
+    lane_times.clear();
+
+    // Every live handle goes stale
+    for (uint32_t slot : slot_of) {
+        slots[slot].generation++;
+        free_slots.push_back(slot);
+    }
+    slot_of.clear();
+    pending_removal.clear();
+}
+
+BubbleHandle BubbleStore::push_back(const Bubble& bubble) {
+    if (isFull()) return BubbleHandle();
+
+    uint32_t slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    else {
+        slot = static_cast<uint32_t>(slots.size());
+        slots.push_back({ 0, 1 });
+    }
+    slots[slot].index = static_cast<uint32_t>(ids.size());
+    slot_of.push_back(slot);
+
+    positions.push_back(bubble.position);
+    velocities.push_back(bubble.velocity);
+    forces.push_back(bubble.force_accumulator);
+    radii.push_back(bubble.radius);
+    masses.push_back(bubble.mass);
+    sleeping.push_back(bubble.sleeping ? 1 : 0);
+    marked_for_removal.push_back(0);
+    ids.push_back(bubble.id);
+    on_surface.push_back(bubble.on_surface ? 1 : 0);
+    surface_ids.push_back(bubble.surface_id);
+    times_on_surface.push_back(bubble.time_on_surface);
+    surface_normals.push_back(bubble.surface_normal);
+    previous_positions.push_back(bubble.position);
+    quiet_steps.push_back(bubble.quiet_steps);
+    sleep_contacts.push_back(bubble.sleep_contacts);
+    slow_lane.push_back(bubble.slow_lane ? 1 : 0);
+    lane_times.push_back(bubble.lane_time);
+
+    if (bubble.marked_for_removal) markForRemoval(ids.size() - 1);
+    return BubbleHandle{ slot, slots[slot].generation };
+}
+
+Bubble BubbleStore::get(size_t index) const {
+    Bubble bubble(ids[index], positions[index], radii[index], velocities[index]);
+    bubble.mass = masses[index];
+    bubble.force_accumulator = forces[index];
+    bubble.on_surface = on_surface[index] != 0;
+    bubble.surface_id = surface_ids[index];
+    bubble.time_on_surface = times_on_surface[index];
+    bubble.surface_normal = surface_normals[index];
+    bubble.sleeping = sleeping[index] != 0;
+    bubble.quiet_steps = quiet_steps[index];
+    bubble.sleep_contacts = sleep_contacts[index];
+    bubble.slow_lane = slow_lane[index] != 0;
+    bubble.lane_time = lane_times[index];
+    bubble.marked_for_removal = marked_for_removal[index] != 0;
+    return bubble;
+}
+
+BubbleHandle BubbleStore::getHandle(size_t index) const {
+    const uint32_t slot = slot_of[index];
+    return BubbleHandle{ slot, slots[slot].generation };
+}
+
+int BubbleStore::indexOf(BubbleHandle handle) const {
+    if (handle.slot >= slots.size() || slots[handle.slot].generation != handle.generation) return -1;
+    return static_cast<int>(slots[handle.slot].index);
+}
+
+void BubbleStore::markForRemoval(size_t index) {
+    if (marked_for_removal[index]) return;
+    marked_for_removal[index] = 1;
+    pending_removal.push_back(static_cast<uint32_t>(index));
+}
+
+template <typename T>
+void BubbleStore::moveLastInto(std::vector<T>& field, size_t index) {
+    field[index] = field.back();
+    field.pop_back();
+}
+
+// Swap-and-pop, the last bubble takes the removed one's index
+void BubbleStore::removeAt(size_t index) {
+    const uint32_t removed_slot = slot_of[index];
+    slots[removed_slot].generation++;
+    free_slots.push_back(removed_slot);
+    slots[slot_of.back()].index = static_cast<uint32_t>(index);
+
+    moveLastInto(positions, index);
+    moveLastInto(velocities, index);
+    moveLastInto(forces, index);
+    moveLastInto(radii, index);
+    moveLastInto(masses, index);
+    moveLastInto(sleeping, index);
+    moveLastInto(marked_for_removal, index);
+    moveLastInto(ids, index);
+    moveLastInto(on_surface, index);
+    moveLastInto(surface_ids, index);
+    moveLastInto(times_on_surface, index);
+    moveLastInto(surface_normals, index);
+    moveLastInto(previous_positions, index);
+    moveLastInto(quiet_steps, index);
+    moveLastInto(sleep_contacts, index);
+    moveLastInto(slow_lane, index);
+    moveLastInto(lane_times, index);
+    moveLastInto(slot_of, index);
+}
+
+void BubbleStore::removeMarked() {
+    // Highest index first, so the bubble moved into a hole is never one still waiting to be removed
+    std::sort(pending_removal.begin(), pending_removal.end(), std::greater<uint32_t>());
+    for (uint32_t index : pending_removal) {
+        removeAt(index);
+    }
+    pending_removal.clear();
+}
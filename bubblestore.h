@@ -0,0 +1,185 @@
+#ifndef BUBBLE_STORE_H
+#define BUBBLE_STORE_H
+
+#include <vector>
+#include <cstdint>
+#include "Bubble.h"
+
+struct ConstBubbleRef;
+
+// Stable reference to a bubble in a BubbleStore. It stays valid while the bubble exists, whatever
+// else is added or removed, and goes stale once the bubble is removed (the slot's generation moves on).
+struct BubbleHandle {
+    uint32_t slot = 0;
+    uint32_t generation = 0; // 0 is never live, so a default handle is always stale
+};
+
+inline bool operator==(BubbleHandle a, BubbleHandle b) { return a.slot == b.slot && a.generation == b.generation; }
+inline bool operator!=(BubbleHandle a, BubbleHandle b) { return !(a == b); }
+
+// References to the fields of one bubble inside a BubbleStore, used like a Bubble&.
+// Flags are stored as bytes (0 or 1) so they can live in plain arrays.
+struct BubbleRef {
+    int& id;
+    glm::vec2& position;
+    glm::vec2& velocity;
+    float& radius;
+    float& mass;
+    glm::vec2& force_accumulator;
+    uint8_t& on_surface;
+    int& surface_id;
+    float& time_on_surface;
+    glm::vec2& surface_normal;
+    uint8_t& sleeping;
+    int& quiet_steps;
+    int& sleep_contacts;
+    uint8_t& slow_lane;
+    float& lane_time;
+    const uint8_t& marked_for_removal; // Set through BubbleStore::markForRemoval
+
+    void updateMass() const { mass = Bubble::calculateMass(radius); }
+    float getArea() const { return glm::pi<float>() * radius * radius; }
+    float getCircumference() const { return 2.0f * glm::pi<float>() * radius; }
+
+    // Read-only view of the same bubble
+    operator ConstBubbleRef() const;
+};
+
+struct ConstBubbleRef {
+    const int& id;
+    const glm::vec2& position;
+    const glm::vec2& velocity;
+    const float& radius;
+    const float& mass;
+    const glm::vec2& force_accumulator;
+    const uint8_t& on_surface;
+    const int& surface_id;
+    const float& time_on_surface;
+    const glm::vec2& surface_normal;
+    const uint8_t& sleeping;
+    const int& quiet_steps;
+    const int& sleep_contacts;
+    const uint8_t& slow_lane;
+    const float& lane_time;
+    const uint8_t& marked_for_removal;
+
+    float getArea() const { return glm::pi<float>() * radius * radius; }
+    float getCircumference() const { return 2.0f * glm::pi<float>() * radius; }
+};
+
+// Structure-of-arrays bubble container. Every Bubble field has its own contiguous array, so a
+// pass only streams the fields it uses. Hot fields (read or written by every pass of a step)
+// are kept apart from the cold surface and bookkeeping fields.
+// bubbles[i] gives a BubbleRef for code that works on one bubble at a time, the get* arrays
+// are for loops over all of them.
+// It is also a generational slot map: the arrays stay dense, and each bubble has a slot that
+// maps its handle to its current index. Removal moves the last bubble into the hole, so it
+// costs O(removed) but does not keep the order; indices are only good until the next removeMarked.
+inline BubbleRef::operator ConstBubbleRef() const {
+    return ConstBubbleRef{ id, position, velocity, radius, mass, force_accumulator, on_surface, surface_id,
+        time_on_surface, surface_normal, sleeping, quiet_steps, sleep_contacts, slow_lane, lane_time, marked_for_removal };
+}
+
+class BubbleStore {
+public:
+    size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+    void reserve(size_t count);
+    void clear();
+
+    // Hard limit, 0 for none. Reserves everything up front, so a store that stays
+    // within its capacity never allocates again.
+    void setCapacity(size_t maxBubbles);
+    size_t getCapacity() const { return capacity; }
+    bool isFull() const { return capacity > 0 && size() >= capacity; }
+
+    // Returns a stale handle without adding anything when the store is full
+    BubbleHandle push_back(const Bubble& bubble);
+    // Copy of one bubble
+    Bubble get(size_t index) const;
+
+    BubbleRef operator[](size_t index) {
+        return BubbleRef{ ids[index], positions[index], velocities[index], radii[index], masses[index], forces[index],
+            on_surface[index], surface_ids[index], times_on_surface[index], surface_normals[index],
+            sleeping[index], quiet_steps[index], sleep_contacts[index], slow_lane[index], lane_times[index],
+            marked_for_removal[index] };
+    }
+    ConstBubbleRef operator[](size_t index) const {
+        return ConstBubbleRef{ ids[index], positions[index], velocities[index], radii[index], masses[index], forces[index],
+            on_surface[index], surface_ids[index], times_on_surface[index], surface_normals[index],
+            sleeping[index], quiet_steps[index], sleep_contacts[index], slow_lane[index], lane_times[index],
+            marked_for_removal[index] };
+    }
+
+    // Handle of the bubble at index
+    BubbleHandle getHandle(size_t index) const;
+    // Current index of the bubble, -1 if the handle is stale
+    int indexOf(BubbleHandle handle) const;
+    bool contains(BubbleHandle handle) const { return indexOf(handle) >= 0; }
+
+    // The bubble stays in place (flagged) until removeMarked
+    void markForRemoval(size_t index);
+    // Drops every bubble marked for removal, in O(removed)
+    void removeMarked();
+
+    // Field arrays, size() entries each
+    glm::vec2* getPositions() { return positions.data(); }
+    const glm::vec2* getPositions() const { return positions.data(); }
+    glm::vec2* getVelocities() { return velocities.data(); }
+    const glm::vec2* getVelocities() const { return velocities.data(); }
+    glm::vec2* getForces() { return forces.data(); }
+    const glm::vec2* getForces() const { return forces.data(); }
+    float* getRadii() { return radii.data(); }
+    const float* getRadii() const { return radii.data(); }
+    float* getMasses() { return masses.data(); }
+    const float* getMasses() const { return masses.data(); }
+    uint8_t* getSleepingFlags() { return sleeping.data(); }
+    const uint8_t* getSleepingFlags() const { return sleeping.data(); }
+    const uint8_t* getRemovalFlags() const { return marked_for_removal.data(); }
+    const int* getIds() const { return ids.data(); }
+
+    // Copies every position into the previous positions, called at the start of a step.
+    // Bubbles added since start with both equal.
+    void storePreviousPositions() { previous_positions = positions; }
+    const glm::vec2* getPreviousPositions() const { return previous_positions.data(); }
+
+private:
+    size_t capacity = 0;
+
+    // Hot
+    std::vector<glm::vec2> positions;
+    std::vector<glm::vec2> velocities;
+    std::vector<glm::vec2> forces;
+    std::vector<float> radii;
+    std::vector<float> masses;
+    std::vector<uint8_t> sleeping;
+    std::vector<uint8_t> marked_for_removal;
+
+    // Cold
+    std::vector<int> ids;
+    std::vector<uint8_t> on_surface;
+    std::vector<int> surface_ids;
+    std::vector<float> times_on_surface;
+    std::vector<glm::vec2> surface_normals;
+    std::vector<glm::vec2> previous_positions; // Positions before the last step, for render interpolation
+    std::vector<int> quiet_steps;
+    std::vector<int> sleep_contacts;
+    std::vector<uint8_t> slow_lane;
+    std::vector<float> lane_times;
+
+    // Slot map
+    struct Slot {
+        uint32_t index;      // Dense index while live, unused while free
+        uint32_t generation; // Bumped on every removal
+    };
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    std::vector<uint32_t> slot_of;        // Dense index -> slot
+    std::vector<uint32_t> pending_removal; // Indices marked since the last removeMarked
+
+    void removeAt(size_t index);
+    template <typename T>
+    static void moveLastInto(std::vector<T>& field, size_t index);
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "BubbleStoreTests.h"
+#include "BubbleStore.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static int failed_checks = 0;
+
+static void check(const char* test, bool passed) {
+    if (passed) return;
+    printf("FAIL %s\n", test);
+    failed_checks++;
+}
+
+static Bubble makeBubble(int id) {
+    return Bubble(id, glm::vec2(static_cast<float>(id), 0.0f), BUBBLE_MIN_RADIUS);
+}
+
+// Live handles point at the bubble they were made for, after any number of swap-and-pop moves
+static bool handlesMatch(const BubbleStore& bubbles, const std::vector<BubbleHandle>& handles, const std::vector<int>& ids) {
+    for (size_t h = 0; h < handles.size(); ++h) {
+        const int index = bubbles.indexOf(handles[h]);
+        if (index < 0 || index >= static_cast<int>(bubbles.size()) || bubbles[index].id != ids[h]) return false;
+    }
+    return true;
+}
+
+// Marks the handle's bubble, a handle that points nowhere is a failure instead of a bad index
+static void markHandle(BubbleStore& bubbles, BubbleHandle handle) {
+    const int index = bubbles.indexOf(handle);
+    check("Handles, a live handle points inside the store", index >= 0 && index < static_cast<int>(bubbles.size()));
+    if (index >= 0 && index < static_cast<int>(bubbles.size())) bubbles.markForRemoval(static_cast<size_t>(index));
+}
+
+static void testRemovalAndReuse() {
+    BubbleStore bubbles;
+    std::vector<BubbleHandle> handles;
+    for (int id = 0; id < 10; ++id) {
+        handles.push_back(bubbles.push_back(makeBubble(id)));
+    }
+    check("Handles, a default handle is stale", !bubbles.contains(BubbleHandle()));
+
+    // The first, a middle one and the last: the last bubbles move into the holes
+    const int removed_ids[] = { 0, 5, 9 };
+    for (int id : removed_ids) {
+        markHandle(bubbles, handles[id]);
+    }
+    check("Handles, a marked bubble keeps its handle until removeMarked", bubbles.contains(handles[5]));
+    bubbles.removeMarked();
+    check("Handles, removeMarked drops the marked bubbles", bubbles.size() == 7);
+
+    std::vector<BubbleHandle> live_handles;
+    std::vector<int> live_ids;
+    for (int id = 0; id < 10; ++id) {
+        if (id == 0 || id == 5 || id == 9) {
+            check("Handles, a removed bubble's handle returns -1", bubbles.indexOf(handles[id]) == -1 && !bubbles.contains(handles[id]));
+            continue;
+        }
+        live_handles.push_back(handles[id]);
+        live_ids.push_back(id);
+    }
+    check("Handles, survivors point at their bubble after swap-and-pop", handlesMatch(bubbles, live_handles, live_ids));
+
+    // New bubbles take the freed slots, with a new generation
+    for (int id = 10; id < 13; ++id) {
+        BubbleHandle handle = bubbles.push_back(makeBubble(id));
+        check("Handles, a freed slot is reused", handle.slot == handles[0].slot || handle.slot == handles[5].slot || handle.slot == handles[9].slot);
+        live_handles.push_back(handle);
+        live_ids.push_back(id);
+    }
+    for (int id : removed_ids) {
+        check("Handles, the old handle of a reused slot stays stale", bubbles.indexOf(handles[id]) == -1);
+    }
+    check("Handles, new and old bubbles point at their bubble", handlesMatch(bubbles, live_handles, live_ids));
+
+    bubbles.clear();
+    for (BubbleHandle handle : live_handles) {
+        check("Handles, clear makes every handle stale", !bubbles.contains(handle));
+    }
+}
+
+// Random rounds of adds and removals against a plain list of what should be live
+static void testRandomRounds() {
+    std::mt19937 engine(4u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    BubbleStore bubbles;
+    std::vector<BubbleHandle> live_handles;
+    std::vector<int> live_ids;
+    std::vector<BubbleHandle> dead_handles;
+    int next_id = 0;
+    for (int round = 0; round < 50; ++round) {
+        const int added = static_cast<int>(unit(engine) * 40.0f);
+        for (int i = 0; i < added; ++i) {
+            live_handles.push_back(bubbles.push_back(makeBubble(next_id)));
+            live_ids.push_back(next_id++);
+        }
+        for (size_t h = 0; h < live_handles.size();) {
+            if (unit(engine) < 0.3f) {
+                markHandle(bubbles, live_handles[h]);
+                dead_handles.push_back(live_handles[h]);
+                live_handles[h] = live_handles.back();
+                live_handles.pop_back();
+                live_ids[h] = live_ids.back();
+                live_ids.pop_back();
+            }
+            else {
+                ++h;
+            }
+        }
+        bubbles.removeMarked();
+    }
+    check("Handles, random rounds keep the live count", bubbles.size() == live_handles.size());
+    check("Handles, random rounds keep every live handle", handlesMatch(bubbles, live_handles, live_ids));
+    bool all_stale = true;
+    for (BubbleHandle handle : dead_handles) {
+        all_stale = all_stale && bubbles.indexOf(handle) == -1;
+    }
+    check("Handles, random rounds leave every removed handle stale", all_stale);
+}
+
+int runBubbleStoreTests() {
+    failed_checks = 0;
+    printf("Bubble store handles\n");
+    testRemovalAndReuse();
+    testRandomRounds();
+    if (failed_checks == 0) printf("All bubble store checks pass\n");
+    else printf("%d checks failed\n", failed_checks);
+    return failed_checks;
+}
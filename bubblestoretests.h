@@ -0,0 +1,8 @@
+#ifndef BUBBLE_STORE_TESTS_H
+#define BUBBLE_STORE_TESTS_H
+
+// BubbleStore handles: they survive swap-and-pop removal, and go stale once their bubble is
+// removed, also after the slot is reused. Returns the number of failed checks.
+int runBubbleStoreTests();
+
+#endif
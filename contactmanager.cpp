@@ -0,0 +1,64 @@
+#include "ContactManager.h"
+#include <algorithm>
+
+void ContactManager::beginStep() {
+    reported.clear();
+    events.clear();
+    begin_count = 0;
+    end_count = 0;
+}
+
+void ContactManager::reportContact(int idA, int idB, glm::vec2 normal, float penetration) {
+    ReportedContact report;
+    if (idA > idB) {
+        std::swap(idA, idB);
+        normal = -normal;
+    }
+    report.key = makeKey(idA, idB);
+    report.contact.id_a = idA;
+    report.contact.id_b = idB;
+    report.contact.age = 0;
+    report.contact.normal = normal;
+    report.contact.penetration = penetration;
+    reported.push_back(report);
+}
+
+void ContactManager::endStep() {
+    std::sort(reported.begin(), reported.end(),
+        [](const ReportedContact& a, const ReportedContact& b) { return a.key < b.key; });
+
+    // Merge this step's reports with last step's contacts, both sorted by key
+    next_contacts.clear();
+    size_t previous = 0;
+    for (size_t r = 0; r < reported.size(); ++r) {
+        const uint64_t key = reported[r].key;
+        if (r > 0 && reported[r - 1].key == key) continue; // Reported twice, keep the first
+
+        while (previous < contacts.size() && makeKey(contacts[previous].id_a, contacts[previous].id_b) < key) {
+            events.push_back({ ContactEventType::End, contacts[previous].id_a, contacts[previous].id_b });
+            end_count++;
+            previous++;
+        }
+
+        BubbleContact contact = reported[r].contact;
+        if (previous < contacts.size() && makeKey(contacts[previous].id_a, contacts[previous].id_b) == key) {
+            contact.age = contacts[previous].age + 1;
+            events.push_back({ ContactEventType::Persist, contact.id_a, contact.id_b });
+            previous++;
+        }
+        else if (contact.penetration <= 0.0f) {
+            continue; // Hysteresis only keeps existing contacts alive, it never starts one
+        }
+        else {
+            events.push_back({ ContactEventType::Begin, contact.id_a, contact.id_b });
+            begin_count++;
+        }
+        next_contacts.push_back(contact);
+    }
+    for (; previous < contacts.size(); ++previous) {
+        events.push_back({ ContactEventType::End, contacts[previous].id_a, contacts[previous].id_b });
+        end_count++;
+    }
+
+    contacts.swap(next_contacts);
+}
@@ -0,0 +1,67 @@
+#ifndef CONTACT_MANAGER_H
+#define CONTACT_MANAGER_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+enum class ContactEventType {
+    Begin,   // Pair started touching this step
+    Persist, // Pair was already touching last step
+    End      // Pair stopped touching (separated, fused or removed)
+};
+
+// Contact between two bubbles, kept across steps while the pair stays close.
+struct BubbleContact {
+    int id_a;           // Lower Bubble::id of the pair
+    int id_b;           // Higher Bubble::id of the pair
+    int age;            // Consecutive steps in contact, 0 on the step it began
+    glm::vec2 normal;   // From a to b, as of the last step it was reported
+    float penetration;  // Overlap depth, negative while separated inside the hysteresis band
+};
+
+struct ContactEvent {
+    ContactEventType type;
+    int id_a;
+    int id_b;
+};
+
+// Keeps active bubble-bubble contacts keyed by (id, id) across steps.
+// The narrowphase reports every pair that is touching or within CONTACT_HYSTERESIS of touching.
+// The hysteresis stops position correction from flipping a pair in and out of contact every step.
+// Contacts are kept sorted by key, so matching against the previous step is a single merge.
+// Every touching pair still goes through the narrowphase each step: the contact springs and
+// constraints depend on the current positions, so a pair that did not change has nothing to skip.
+// Nothing is warm started from the stored contacts either: the spring modes carry no solver state,
+// and seeding the XPBD pairs with last step's force did not cut the overlap left at any iteration count.
+class ContactManager {
+public:
+    void beginStep();
+    void reportContact(int idA, int idB, glm::vec2 normal, float penetration);
+    // Matches reported pairs against the previous step and emits begin/persist/end events
+    void endStep();
+
+    const std::vector<BubbleContact>& getContacts() const { return contacts; }
+    const std::vector<ContactEvent>& getEvents() const { return events; }
+    size_t getBeginCount() const { return begin_count; }
+    size_t getEndCount() const { return end_count; }
+
+private:
+    struct ReportedContact {
+        uint64_t key;
+        BubbleContact contact;
+    };
+
+    std::vector<BubbleContact> contacts;       // Active contacts, sorted by (id_a, id_b)
+    std::vector<BubbleContact> next_contacts;  // Built by endStep, swapped with contacts
+    std::vector<ReportedContact> reported;     // Reports of the current step
+    std::vector<ContactEvent> events;
+    size_t begin_count = 0;
+    size_t end_count = 0;
+
+    static uint64_t makeKey(int idA, int idB) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(idA)) << 32) | static_cast<uint32_t>(idB);
+    }
+};
+
+#endif
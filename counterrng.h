@@ -0,0 +1,52 @@
+#ifndef COUNTER_RNG_H
+#define COUNTER_RNG_H
+
+#include <cstdint>
+
+// Stateless counter-based random numbers (Philox4x32-10, Salmon et al. 2011).
+// The output is a pure function of a 128 bit counter and a 64 bit key, so any thread can draw
+// the number for any (step, pair) without sharing an engine, and gets the same answer every run.
+struct PhiloxBlock {
+    uint32_t v[4];
+};
+
+inline PhiloxBlock philox4x32(PhiloxBlock counter, uint64_t key) {
+    const uint32_t multiplier0 = 0xD2511F53u;
+    const uint32_t multiplier1 = 0xCD9E8D57u;
+    const uint32_t weyl0 = 0x9E3779B9u;
+    const uint32_t weyl1 = 0xBB67AE85u;
+
+    uint32_t key0 = static_cast<uint32_t>(key);
+    uint32_t key1 = static_cast<uint32_t>(key >> 32);
+    for (int round = 0; round < 10; ++round) {
+        uint64_t product0 = static_cast<uint64_t>(multiplier0) * counter.v[0];
+        uint64_t product1 = static_cast<uint64_t>(multiplier1) * counter.v[2];
+        PhiloxBlock next;
+        next.v[0] = static_cast<uint32_t>(product1 >> 32) ^ counter.v[1] ^ key0;
+        next.v[1] = static_cast<uint32_t>(product1);
+        next.v[2] = static_cast<uint32_t>(product0 >> 32) ^ counter.v[3] ^ key1;
+        next.v[3] = static_cast<uint32_t>(product0);
+        counter = next;
+        key0 += weyl0;
+        key1 += weyl1;
+    }
+    return counter;
+}
+
+// Uniform float in [0, 1) for the pair (idA, idB) at the given step, the order of the ids doesn't matter
+inline float counterUniform(uint64_t seed, uint64_t step, int idA, int idB) {
+    if (idA > idB) {
+        int swap = idA;
+        idA = idB;
+        idB = swap;
+    }
+    PhiloxBlock counter = { {
+        static_cast<uint32_t>(step),
+        static_cast<uint32_t>(step >> 32),
+        static_cast<uint32_t>(idA),
+        static_cast<uint32_t>(idB) } };
+    // Top 24 bits, exactly representable as a float
+    return (philox4x32(counter, seed).v[0] >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif
@@ -1,19 +1,168 @@
 #include "fluidgrid2d.h"
-#include "bubble.h"
 #include <algorithm>
+#include <cmath>
 
-FluidGrid2D::FluidGrid2D(int screenWidth, int screenHeight) {
-    width_cells = screenWidth / GRID_CELL_SIZE;
-    height_cells = screenHeight / GRID_CELL_SIZE;
-    velocities.resize(width_cells * height_cells, glm::vec2(0.0f, 0.0f));
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+const char* getFluidSamplingName(FluidSampling sampling) {
+    switch (sampling) {
+    case FluidSampling::Nearest: return "Nearest";
+    case FluidSampling::Bilinear: return "Bilinear";
+    }
+    return "Unknown";
+}
+
+const char* getFluidSolverName(FluidSolver solver) {
+    switch (solver) {
+    case FluidSolver::Damping: return "Damping";
+    case FluidSolver::StableFluids: return "Stable fluids";
+    }
+    return "Unknown";
+}
+
+// What the sampling kernels read, the grid coordinate of a point is clamped to [0, max]
+struct FluidSampleGrid {
+    const glm::vec2* velocities; // Storage of cell (0, 0), ghost cells around it
+    int stride;
+    float max_x;
+    float max_y;
+};
+
+static glm::vec2 sampleNearest(const FluidSampleGrid& grid, glm::vec2 position) {
+    float gx = glm::clamp(position.x / GRID_CELL_SIZE, 0.0f, grid.max_x);
+    float gy = glm::clamp(position.y / GRID_CELL_SIZE, 0.0f, grid.max_y);
+    return grid.velocities[static_cast<int>(gy) * grid.stride + static_cast<int>(gx)];
+}
+
+// Between cell centers; past the last center the ghost cell repeats the edge
+static glm::vec2 sampleBilinear(const FluidSampleGrid& grid, glm::vec2 position) {
+    float gx = glm::clamp(position.x / GRID_CELL_SIZE - 0.5f, 0.0f, grid.max_x);
+    float gy = glm::clamp(position.y / GRID_CELL_SIZE - 0.5f, 0.0f, grid.max_y);
+    int x = static_cast<int>(gx);
+    int y = static_cast<int>(gy);
+    float fx = gx - static_cast<float>(x);
+    float fy = gy - static_cast<float>(y);
+
+    const glm::vec2* cell = grid.velocities + y * grid.stride + x;
+    glm::vec2 bottom = cell[0] + (cell[1] - cell[0]) * fx;
+    glm::vec2 top = cell[grid.stride] + (cell[grid.stride + 1] - cell[grid.stride]) * fx;
+    return bottom + (top - bottom) * fy;
+}
+
+static void sampleScalar(const FluidSampleGrid& grid, FluidSampling sampling, const glm::vec2* positions, size_t begin, size_t end, glm::vec2* out) {
+    if (sampling == FluidSampling::Bilinear) {
+        for (size_t i = begin; i < end; ++i) out[i] = sampleBilinear(grid, positions[i]);
+    }
+    else {
+        for (size_t i = begin; i < end; ++i) out[i] = sampleNearest(grid, positions[i]);
+    }
+}
+
+#if defined(SIMD_X86)
+// Velocities of 4 cells, interleaved. The masked form with a zero source, the plain one trips
+// uninitialized warnings in some GCC versions.
+SIMD_AVX2_TARGET
+static inline __m256 gatherCells(const double* cells, __m128i index) {
+    const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    return _mm256_castpd_ps(_mm256_mask_i32gather_pd(_mm256_setzero_pd(), cells, index, all, 8));
+}
+
+// 4 points per iteration, each cell read is a 64 bit gather of 4 velocities
+SIMD_AVX2_TARGET
+static size_t sampleAvx2(const FluidSampleGrid& grid, FluidSampling sampling, const glm::vec2* positions, size_t begin, size_t end, glm::vec2* out) {
+    const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i duplicate = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m128 cell_size = _mm_set1_ps(static_cast<float>(GRID_CELL_SIZE));
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_x = _mm_set1_ps(grid.max_x);
+    const __m128 max_y = _mm_set1_ps(grid.max_y);
+    const __m128i stride = _mm_set1_epi32(grid.stride);
+    const __m128i one = _mm_set1_epi32(1);
+    const double* cells = reinterpret_cast<const double*>(grid.velocities);
+    const bool bilinear = sampling == FluidSampling::Bilinear;
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m256 points = _mm256_permutevar8x32_ps(_mm256_loadu_ps(&positions[i].x), deinterleave);
+        __m128 gx = _mm_div_ps(_mm256_castps256_ps128(points), cell_size);
+        __m128 gy = _mm_div_ps(_mm256_extractf128_ps(points, 1), cell_size);
+        if (bilinear) {
+            gx = _mm_sub_ps(gx, half);
+            gy = _mm_sub_ps(gy, half);
+        }
+        gx = _mm_min_ps(_mm_max_ps(gx, zero), max_x);
+        gy = _mm_min_ps(_mm_max_ps(gy, zero), max_y);
+        __m128i x = _mm_cvttps_epi32(gx);
+        __m128i y = _mm_cvttps_epi32(gy);
+        __m128i index = _mm_add_epi32(_mm_mullo_epi32(y, stride), x);
+
+        __m256 v00 = gatherCells(cells, index);
+        if (!bilinear) {
+            _mm256_storeu_ps(&out[i].x, v00);
+            continue;
+        }
+        __m256 v10 = gatherCells(cells, _mm_add_epi32(index, one));
+        __m256 v01 = gatherCells(cells, _mm_add_epi32(index, stride));
+        __m256 v11 = gatherCells(cells, _mm_add_epi32(_mm_add_epi32(index, stride), one));
+        // Weights into both lanes of their point
+        __m256 fx = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_sub_ps(gx, _mm_cvtepi32_ps(x))), duplicate);
+        __m256 fy = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(_mm_sub_ps(gy, _mm_cvtepi32_ps(y))), duplicate);
+        __m256 bottom = _mm256_add_ps(v00, _mm256_mul_ps(_mm256_sub_ps(v10, v00), fx));
+        __m256 top = _mm256_add_ps(v01, _mm256_mul_ps(_mm256_sub_ps(v11, v01), fx));
+        _mm256_storeu_ps(&out[i].x, _mm256_add_ps(bottom, _mm256_mul_ps(_mm256_sub_ps(top, bottom), fy)));
+    }
+    return i;
+}
+#endif
+
+FluidGrid2D::FluidGrid2D(int screenWidth, int screenHeight)
+    : width_cells(screenWidth / GRID_CELL_SIZE),
+    height_cells(screenHeight / GRID_CELL_SIZE),
+    stride(width_cells + 2),
+    sampling(FluidSampling::Nearest),
+    simd_level(detectSimdLevel()),
+    solver(FluidSolver::Damping),
+    pressure_iterations(FLUID_PRESSURE_ITERATIONS),
+    pressure_tolerance(FLUID_PRESSURE_TOLERANCE),
+    step_budget_ms(FLUID_STEP_BUDGET_MS),
+    pressure_solver(width_cells, height_cells) {
+    velocities.resize(stride * (height_cells + 2), glm::vec2(0.0f, 0.0f));
+    pressure.resize(velocities.size(), 0.0f);
+    divergence.resize(velocities.size(), 0.0f);
+    departure_points.resize(width_cells * height_cells);
+    advected.resize(width_cells * height_cells);
+}
+
+void FluidGrid2D::setSimdLevel(SimdLevel level) {
+    // NEON has no gather, only AVX2 has a kernel
+    simd_level = level == SimdLevel::Avx2 && level == detectSimdLevel() ? level : SimdLevel::Scalar;
 }
 
 void FluidGrid2D::update(float dt) {
+    if (solver == FluidSolver::StableFluids) {
+        auto start = std::chrono::steady_clock::now();
+        advect(dt);
+        project(start);
+        last_solve.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Ghost cells too, they stay copies of their edge cells
     for (glm::vec2& vel : velocities) {
         vel *= (1.0f - 0.1f * dt); // Simple fluid damping
     }
 }
 
+float FluidGrid2D::getMaxSpeed() const {
+    float max_speed_sq = 0.0f;
+    for (const glm::vec2& vel : velocities) {
+        max_speed_sq = std::max(max_speed_sq, glm::dot(vel, vel));
+    }
+    return glm::sqrt(max_speed_sq);
+}
+
 glm::ivec2 FluidGrid2D::getCellIndex(glm::vec2 position) const {
     int x_idx = static_cast<int>(position.x / GRID_CELL_SIZE);
     int y_idx = static_cast<int>(position.y / GRID_CELL_SIZE);
@@ -23,14 +172,126 @@ glm::ivec2 FluidGrid2D::getCellIndex(glm::vec2 position) const {
     );
 }
 
+void FluidGrid2D::updateGhostCells(int x, int y) {
+    const glm::vec2 velocity = velocities[getIndex(x, y)];
+    const int ghost_x = x == 0 ? -1 : (x == width_cells - 1 ? width_cells : x);
+    const int ghost_y = y == 0 ? -1 : (y == height_cells - 1 ? height_cells : y);
+    if (ghost_x != x) velocities[getIndex(ghost_x, y)] = velocity;
+    if (ghost_y != y) velocities[getIndex(x, ghost_y)] = velocity;
+    if (ghost_x != x && ghost_y != y) velocities[getIndex(ghost_x, ghost_y)] = velocity; // Corner
+}
+
 glm::vec2 FluidGrid2D::getVelocityAt(glm::vec2 position) const {
-    // Simple nearest neighbor for now
-    // Can be bi-linear interpolation for smoother results
-    glm::ivec2 cell_idx = getCellIndex(position);
-    if (cell_idx.x >= 0 && cell_idx.x < width_cells && cell_idx.y >= 0 && cell_idx.y < height_cells) {
-        return velocities[cell_idx.y * width_cells + cell_idx.x];
+    glm::vec2 velocity;
+    getVelocitiesAt(&position, 1, &velocity);
+    return velocity;
+}
+
+void FluidGrid2D::getVelocitiesAt(const glm::vec2* positions, size_t count, glm::vec2* out) const {
+    sampleVelocities(sampling, positions, count, out);
+}
+
+void FluidGrid2D::sampleVelocities(FluidSampling mode, const glm::vec2* positions, size_t count, glm::vec2* out) const {
+    const FluidSampleGrid grid = { velocities.data() + getIndex(0, 0), stride,
+        static_cast<float>(width_cells - 1), static_cast<float>(height_cells - 1) };
+    size_t done = 0;
+#if defined(SIMD_X86)
+    if (simd_level == SimdLevel::Avx2) done = sampleAvx2(grid, mode, positions, 0, count, out);
+#endif
+    sampleScalar(grid, mode, positions, done, count, out);
+}
+
+template <typename T>
+void FluidGrid2D::fillGhostCells(std::vector<T>& field) const {
+    for (int x = 0; x < width_cells; ++x) {
+        field[getIndex(x, -1)] = field[getIndex(x, 0)];
+        field[getIndex(x, height_cells)] = field[getIndex(x, height_cells - 1)];
+    }
+    // Corners from the rows just filled
+    for (int y = -1; y <= height_cells; ++y) {
+        field[getIndex(-1, y)] = field[getIndex(0, y)];
+        field[getIndex(width_cells, y)] = field[getIndex(width_cells - 1, y)];
+    }
+}
+
+// --- Stable fluids ---
+
+// Semi-Lagrangian: every cell center takes the velocity found one step back along its own velocity,
+// read bilinearly from the field before the step. Unconditionally stable, whatever the dt.
+void FluidGrid2D::advect(float dt) {
+    for (int y = 0; y < height_cells; ++y) {
+        for (int x = 0; x < width_cells; ++x) {
+            glm::vec2 center((x + 0.5f) * GRID_CELL_SIZE, (y + 0.5f) * GRID_CELL_SIZE);
+            departure_points[y * width_cells + x] = center - velocities[getIndex(x, y)] * dt;
+        }
+    }
+    sampleVelocities(FluidSampling::Bilinear, departure_points.data(), departure_points.size(), advected.data());
+    for (int y = 0; y < height_cells; ++y) {
+        for (int x = 0; x < width_cells; ++x) {
+            velocities[getIndex(x, y)] = advected[y * width_cells + x];
+        }
+    }
+}
+
+// Removes the divergent part of the velocities: solves laplacian(p) = div(u) with the PoissonSolver
+// and subtracts grad(p). The grid edges and solid cells are closed walls, pressure has no flux through
+// them. Central differences on the cell centers, as in Stam's "Real-Time Fluid Dynamics for Games".
+void FluidGrid2D::project(std::chrono::steady_clock::time_point start) {
+    const float h = static_cast<float>(GRID_CELL_SIZE);
+    const float* open = pressure_solver.getOpenFlags();
+
+    // Walls: a closed neighbour stands in with the cell's normal velocity mirrored, so it averages
+    // to zero on the wall. The ghost ring is closed, so this covers the grid edges too.
+    float max_divergence = 0.0f;
+    for (int y = 0; y < height_cells; ++y) {
+        for (int x = 0; x < width_cells; ++x) {
+            const int k = getIndex(x, y);
+            const glm::vec2 v = velocities[k];
+            const float right = open[k + 1] * velocities[k + 1].x - (1.0f - open[k + 1]) * v.x;
+            const float left = open[k - 1] * velocities[k - 1].x - (1.0f - open[k - 1]) * v.x;
+            const float top = open[k + stride] * velocities[k + stride].y - (1.0f - open[k + stride]) * v.y;
+            const float bottom = open[k - stride] * velocities[k - stride].y - (1.0f - open[k - stride]) * v.y;
+            divergence[k] = open[k] * 0.5f * h * (right - left + top - bottom);
+            max_divergence = std::max(max_divergence, std::abs(divergence[k]));
+        }
+    }
+
+    // The last step's pressure is the first guess, the flow changes little between steps
+    last_solve.iterations = 0;
+    last_solve.residual = 0.0f;
+    last_solve.over_budget = false;
+    if (max_divergence > 0.0f) {
+        float budget = 0.0f;
+        if (step_budget_ms > 0.0f) {
+            // Whatever advection left, at least one iteration
+            const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            budget = std::max(step_budget_ms - elapsed, 1.0e-3f);
+        }
+        last_solve.iterations = pressure_solver.solve(pressure.data() + getIndex(0, 0), divergence.data() + getIndex(0, 0), stride,
+            pressure_iterations, pressure_tolerance, budget);
+        last_solve.residual = pressure_solver.getLastResidual();
+        last_solve.over_budget = pressure_solver.wasOverBudget();
+    }
+
+    for (int y = 0; y < height_cells; ++y) {
+        for (int x = 0; x < width_cells; ++x) {
+            const int k = getIndex(x, y);
+            if (open[k] == 0.0f) {
+                velocities[k] = glm::vec2(0.0f);
+                continue;
+            }
+            // A closed neighbour has the cell's own pressure, no gradient into the wall
+            const float p = pressure[k];
+            const float right = open[k + 1] * pressure[k + 1] + (1.0f - open[k + 1]) * p;
+            const float left = open[k - 1] * pressure[k - 1] + (1.0f - open[k - 1]) * p;
+            const float top = open[k + stride] * pressure[k + stride] + (1.0f - open[k + stride]) * p;
+            const float bottom = open[k - stride] * pressure[k - stride] + (1.0f - open[k - stride]) * p;
+            velocities[k].x -= 0.5f * (right - left) / h;
+            velocities[k].y -= 0.5f * (top - bottom) / h;
+        }
     }
-    return glm::vec2(0.0f, 0.0f); // Out of bounds
+    // Ghost cells back to plain copies for sampling
+    fillGhostCells(velocities);
 }
 
 float FluidGrid2D::getVorticityAt(glm::vec2 position) const {
@@ -38,11 +299,11 @@ float FluidGrid2D::getVorticityAt(glm::vec2 position) const {
     // Vorticity (2D scalar) = d(vy)/dx - d(vx)/dy
     glm::ivec2 P = getCellIndex(position);
 
-    // Get velocities of neighboring cells
-    glm::vec2 v_L = getVelocityAt(glm::vec2((P.x - 1) * GRID_CELL_SIZE + GRID_CELL_SIZE / 2.0f, P.y * GRID_CELL_SIZE + GRID_CELL_SIZE / 2.0f));
-    glm::vec2 v_R = getVelocityAt(glm::vec2((P.x + 1) * GRID_CELL_SIZE + GRID_CELL_SIZE / 2.0f, P.y * GRID_CELL_SIZE + GRID_CELL_SIZE / 2.0f));
-    glm::vec2 v_B = getVelocityAt(glm::vec2(P.x * GRID_CELL_SIZE + GRID_CELL_SIZE / 2.0f, (P.y - 1) * GRID_CELL_SIZE + GRID_CELL_SIZE / 2.0f));
-    glm::vec2 v_T = getVelocityAt(glm::vec2(P.x * GRID_CELL_SIZE + GRID_CELL_SIZE / 2.0f, (P.y + 1) * GRID_CELL_SIZE + GRID_CELL_SIZE / 2.0f));
+    // Velocities of neighboring cells, ghost cells at the edges
+    glm::vec2 v_L = velocities[getIndex(P.x - 1, P.y)];
+    glm::vec2 v_R = velocities[getIndex(P.x + 1, P.y)];
+    glm::vec2 v_B = velocities[getIndex(P.x, P.y - 1)];
+    glm::vec2 v_T = velocities[getIndex(P.x, P.y + 1)];
 
     float dvx_dy = (v_T.x - v_B.x) / (4.0f * GRID_CELL_SIZE);
     float dvy_dx = (v_R.y - v_L.y) / (4.0f * GRID_CELL_SIZE);
@@ -53,13 +314,12 @@ float FluidGrid2D::getVorticityAt(glm::vec2 position) const {
 }
 
 
-void FluidGrid2D::applyBubbleForce(const Bubble& bubble, float dt) {
+void FluidGrid2D::applyBubbleForce(ConstBubbleRef bubble, float dt) {
 // Simplified: bubble "pushes" fluid in its direction of motion
 
     glm::ivec2 cell_idx = getCellIndex(bubble.position);
     if (cell_idx.x >= 0 && cell_idx.x < width_cells && cell_idx.y >= 0 && cell_idx.y < height_cells) {
         float influence_radius = bubble.radius * 1.5f;
-        float bubble_force_magnitude = bubble.mass * glm::length(bubble.velocity) / dt; // Estimate with F = m*v / delta t
 
         // Spread influence to nearby cells
         for (int y_offset = -1; y_offset <= 1; ++y_offset) {
@@ -78,7 +338,8 @@ void FluidGrid2D::applyBubbleForce(const Bubble& bubble, float dt) {
                         // Add a portion of the bubble's force to the fluid cell's velocity
                         // For now, let's just use bubble's velocity to "stir" the fluid.
                         glm::vec2 force_on_fluid = bubble.velocity * bubble.mass * weight * 0.1f; // Factor for tuning
-                        velocities[current_cell_idx.y * width_cells + current_cell_idx.x] += force_on_fluid * dt / (float)GRID_CELL_SIZE; // Divide by cell "mass" conceptually
+                        velocities[getIndex(current_cell_idx.x, current_cell_idx.y)] += force_on_fluid * dt / (float)GRID_CELL_SIZE; // Divide by cell "mass" conceptually
+                        updateGhostCells(current_cell_idx.x, current_cell_idx.y);
                     }
                 }
             }
@@ -2,26 +2,94 @@
 #define FLUID_GRID_2D_H
 
 #include <vector>
+#include <chrono>
 #include <glm/glm.hpp>
 #include "SimulationConstants.h"
+#include "BubbleStore.h"
+#include "Simd.h"
+#include "PoissonSolver.h"
 
-struct Bubble;
+// How the fluid velocity at a point is read from the grid.
+enum class FluidSampling {
+    Nearest, // Velocity of the cell the point is in
+    Bilinear // Blend of the four nearest cell centers
+};
+
+const char* getFluidSamplingName(FluidSampling sampling);
+
+// What FluidGrid2D::update does with the velocities.
+enum class FluidSolver {
+    Damping,     // Only damps them, nothing moves with the flow
+    StableFluids // Semi-Lagrangian advection and a pressure projection (Stam 1999), then the damping
+};
+
+const char* getFluidSolverName(FluidSolver solver);
+
+// Cost and accuracy of the last StableFluids update
+struct FluidSolveStats {
+    int iterations = 0;        // Pressure iterations run, sweeps or V-cycles depending on the method
+    float residual = 0.0f;     // Largest pressure residual at the end, relative to the largest divergence
+    float milliseconds = 0.0f; // Whole update
+    bool over_budget = false;  // The pressure solve stopped at the step budget, before the tolerance
+};
 
 // Simplified 2D grid to store fluid simulation data.
+// The cells are surrounded by a ring of ghost cells that repeat their edge neighbour, so lookups
+// clamp the point once and never check bounds, and interpolation can always read the next cell.
 class FluidGrid2D {
 public:
     FluidGrid2D(int screenWidth, int screenHeight);
 
+    // Forces from the bubbles (applyBubbleForce) since the last update are the external forces of the
+    // StableFluids step, which advects and projects them
     void update(float dt);
 
-    // Get interpolated fluid velocity at a given world position
+    // Damping by default
+    void setSolver(FluidSolver mode) { solver = mode; }
+    FluidSolver getSolver() const { return solver; }
+    // Multigrid CG by default, plain V-cycles slow down around the ends of solid surfaces
+    void setPressureMethod(PoissonMethod method) { pressure_solver.setMethod(method); }
+    PoissonMethod getPressureMethod() const { return pressure_solver.getMethod(); }
+    // Pressure solve limits: the iterations stop at the tolerance, the iteration count or once the
+    // update has taken budgetMs (0 for no limit), whichever comes first. A budget makes the result
+    // depend on the machine, so there is none by default.
+    void setPressureIterations(int iterations) { pressure_iterations = iterations; }
+    int getPressureIterations() const { return pressure_iterations; }
+    void setPressureTolerance(float tolerance) { pressure_tolerance = tolerance; }
+    float getPressureTolerance() const { return pressure_tolerance; }
+    void setStepBudget(float budgetMs) { step_budget_ms = budgetMs; }
+    float getStepBudget() const { return step_budget_ms; }
+    const FluidSolveStats& getLastSolveStats() const { return last_solve; }
+
+    int getWidthCells() const { return width_cells; }
+    int getHeightCells() const { return height_cells; }
+
+    // Cells the surface passes through become solid walls for the StableFluids step, the flow goes
+    // around them. Damping ignores them.
+    void addSolidSurface(const Surface2D& surface) { pressure_solver.addSurface(surface, static_cast<float>(GRID_CELL_SIZE)); }
+    void clearSolidSurfaces() { pressure_solver.clearSolids(); }
+
+    // Fluid velocity at a given world position, with the sampling mode
     glm::vec2 getVelocityAt(glm::vec2 position) const;
+    // getVelocityAt for count positions, written to out. Runs the gather kernel of the SIMD level.
+    void getVelocitiesAt(const glm::vec2* positions, size_t count, glm::vec2* out) const;
+
+    // Nearest by default
+    void setSampling(FluidSampling mode) { sampling = mode; }
+    FluidSampling getSampling() const { return sampling; }
+
+    // Kernel of getVelocitiesAt, unsupported levels fall back to scalar
+    void setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel() const { return simd_level; }
+
+    // Fastest cell velocity, for the step size limit
+    float getMaxSpeed() const;
 
     // Get interpolated vorticity at a given world position (simplified for now)
     float getVorticityAt(glm::vec2 position) const;
 
     // Apply force from bubbles to the fluid (simplified)
-    void applyBubbleForce(const Bubble& bubble, float dt);
+    void applyBubbleForce(ConstBubbleRef bubble, float dt);
 
     // Debug draw the grid velocities
     void drawGridVelocities(/* add some rendering context or shader (future work) */);
@@ -29,7 +97,34 @@ public:
 private:
     int width_cells;  // Number of cells horizontally
     int height_cells; // Number of cells vertically
-    std::vector<glm::vec2> velocities; // Stores velocity for each cell center
+    int stride;       // Cells per stored row, width_cells plus the two ghost columns
+    std::vector<glm::vec2> velocities; // Stores velocity for each cell center, ghost cells included
+    FluidSampling sampling;
+    SimdLevel simd_level;
+
+    // StableFluids
+    FluidSolver solver;
+    int pressure_iterations;
+    float pressure_tolerance;
+    float step_budget_ms;
+    FluidSolveStats last_solve;
+    PoissonSolver pressure_solver; // Also holds the solid cells, its open flags share the velocities layout
+    std::vector<float> pressure;   // Same layout as velocities, kept as the next solve's first guess
+    std::vector<float> divergence; // Same layout as velocities, the right hand side of the pressure solve
+    std::vector<glm::vec2> departure_points; // Per cell, row by row without ghosts
+    std::vector<glm::vec2> advected;         // Per cell, row by row without ghosts
+
+    // Storage index of cell (x, y), -1 and width_cells / height_cells are the ghost cells
+    int getIndex(int x, int y) const { return (y + 1) * stride + (x + 1); }
+    // Copies cell (x, y) into the ghost cells next to it, if it is an edge cell
+    void updateGhostCells(int x, int y);
+    // Copies every edge cell of a field into its ghost cells
+    template <typename T>
+    void fillGhostCells(std::vector<T>& field) const;
+    void sampleVelocities(FluidSampling mode, const glm::vec2* positions, size_t count, glm::vec2* out) const;
+
+    void advect(float dt);
+    void project(std::chrono::steady_clock::time_point start); // The budget counts from start
 
     // Function to get cell index from world pos
     glm::ivec2 getCellIndex(glm::vec2 position) const;
@@ -0,0 +1,128 @@
+#include "ImplicitContactSolver.h"
+#include "SimulationConstants.h"
+
+const char* getIntegrationModeName(IntegrationMode mode) {
+    switch (mode) {
+    case IntegrationMode::Explicit: return "Explicit";
+    case IntegrationMode::Implicit: return "Implicit";
+    case IntegrationMode::Xpbd: return "XPBD";
+    }
+    return "Unknown";
+}
+
+ImplicitContactSolver::ImplicitContactSolver()
+    : max_iterations(IMPLICIT_CG_ITERATIONS),
+    last_iterations(0),
+    last_residual(0.0f) {
+}
+
+void ImplicitContactSolver::addContact(int a, int b, glm::vec2 normal) {
+    contacts.push_back({ a, b, normal });
+}
+
+// result = (M + coupling * L) x over the free bubbles, fixed bubbles count as x = 0
+void ImplicitContactSolver::multiply(const std::vector<glm::vec2>& x, std::vector<glm::vec2>& result,
+    const float* masses, float coupling) const {
+    for (size_t i = 0; i < x.size(); ++i) {
+        result[i] = free_bubble[i] ? masses[i] * x[i] : glm::vec2(0.0f);
+    }
+    for (const Contact& contact : contacts) {
+        const glm::vec2 relative = x[contact.a] - x[contact.b];
+        const glm::vec2 term = coupling * glm::dot(contact.normal, relative) * contact.normal;
+        if (free_bubble[contact.a]) result[contact.a] += term;
+        if (free_bubble[contact.b]) result[contact.b] -= term;
+    }
+}
+
+void ImplicitContactSolver::precondition() {
+    for (size_t i = 0; i < residual.size(); ++i) {
+        preconditioned[i] = inverse_diagonal[i] * residual[i];
+    }
+}
+
+float ImplicitContactSolver::dot(const std::vector<glm::vec2>& a, const std::vector<glm::vec2>& b) const {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        sum += static_cast<double>(a[i].x) * b[i].x + static_cast<double>(a[i].y) * b[i].y;
+    }
+    return static_cast<float>(sum);
+}
+
+const glm::vec2* ImplicitContactSolver::solve(const BubbleStore& bubbles, float dt) {
+    const size_t bubble_count = bubbles.size();
+    const glm::vec2* velocities = bubbles.getVelocities();
+    const glm::vec2* forces = bubbles.getForces();
+    const float* masses = bubbles.getMasses();
+    const uint8_t* sleeping = bubbles.getSleepingFlags();
+    const uint8_t* removed = bubbles.getRemovalFlags();
+
+    free_bubble.resize(bubble_count);
+    velocity_change.assign(bubble_count, glm::vec2(0.0f));
+    residual.resize(bubble_count);
+    direction.resize(bubble_count);
+    preconditioned.resize(bubble_count);
+    product.resize(bubble_count);
+    inverse_diagonal.resize(bubble_count);
+
+    const float stiffness_term = dt * dt * BUBBLE_COLLISION_STIFFNESS;
+    const float coupling = dt * BUBBLE_COLLISION_DAMPING + stiffness_term;
+
+    // Right hand side dt * F - dt^2 * k * L * v, and the diagonal blocks M + coupling * sum(n n^T)
+    for (size_t i = 0; i < bubble_count; ++i) {
+        free_bubble[i] = !sleeping[i] && !removed[i];
+        residual[i] = free_bubble[i] ? dt * forces[i] : glm::vec2(0.0f);
+        inverse_diagonal[i] = glm::mat2(masses[i]);
+    }
+    for (const Contact& contact : contacts) {
+        const glm::vec2 n = contact.normal;
+        const glm::vec2 term = stiffness_term * glm::dot(n, velocities[contact.a] - velocities[contact.b]) * n;
+        const glm::mat2 block = coupling * glm::outerProduct(n, n);
+        if (free_bubble[contact.a]) {
+            residual[contact.a] -= term;
+            inverse_diagonal[contact.a] += block;
+        }
+        if (free_bubble[contact.b]) {
+            residual[contact.b] += term;
+            inverse_diagonal[contact.b] += block;
+        }
+    }
+    for (size_t i = 0; i < bubble_count; ++i) {
+        // Fixed bubbles get a zero block, which keeps their entries of every search direction at zero
+        const bool invertible = free_bubble[i] && glm::determinant(inverse_diagonal[i]) > 0.0f;
+        inverse_diagonal[i] = invertible ? glm::inverse(inverse_diagonal[i]) : glm::mat2(0.0f);
+    }
+
+    // Preconditioned conjugate gradients from dv = 0, so the first residual is the right hand side
+    last_iterations = 0;
+    last_residual = 0.0f;
+    const float rhs_norm = dot(residual, residual);
+    if (rhs_norm <= 0.0f) return velocity_change.data();
+
+    precondition();
+    direction = preconditioned;
+    float residual_dot = dot(residual, preconditioned);
+    float residual_norm = rhs_norm;
+    const float tolerance = IMPLICIT_CG_TOLERANCE * IMPLICIT_CG_TOLERANCE * rhs_norm;
+    while (last_iterations < max_iterations && residual_norm > tolerance) {
+        multiply(direction, product, masses, coupling);
+        const float curvature = dot(direction, product);
+        if (curvature <= 0.0f) break;
+        const float step = residual_dot / curvature;
+        for (size_t i = 0; i < bubble_count; ++i) {
+            velocity_change[i] += step * direction[i];
+            residual[i] -= step * product[i];
+        }
+        last_iterations++;
+
+        residual_norm = dot(residual, residual);
+        precondition();
+        const float next_residual_dot = dot(residual, preconditioned);
+        const float beta = next_residual_dot / residual_dot;
+        residual_dot = next_residual_dot;
+        for (size_t i = 0; i < bubble_count; ++i) {
+            direction[i] = preconditioned[i] + beta * direction[i];
+        }
+    }
+    last_residual = glm::sqrt(residual_norm / rhs_norm);
+    return velocity_change.data();
+}
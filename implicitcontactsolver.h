@@ -0,0 +1,68 @@
+#ifndef IMPLICIT_CONTACT_SOLVER_H
+#define IMPLICIT_CONTACT_SOLVER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BubbleStore.h"
+
+// How bubble velocities are advanced from the accumulated forces.
+enum class IntegrationMode {
+    Explicit, // v += F / m * dt, contact springs evaluated at the start of the step
+    Implicit, // Contact springs and damping taken at the end of the step (linearized backward Euler)
+    Xpbd      // Contacts and adhesion as position constraints, see XpbdContactSolver
+};
+
+const char* getIntegrationModeName(IntegrationMode mode);
+
+// Linearized backward Euler for the bubble-bubble contact springs.
+// Each contact contributes stiffness k and damping c along its normal n, so the velocity change of
+// the step solves
+//     (M + (dt * c + dt^2 * k) * L) dv = dt * F - dt^2 * k * L * v
+// where F holds every force gathered this step (the contact forces at the current state included)
+// and L is the contact graph Laplacian with n n^T blocks. The matrix is symmetric positive definite
+// and is solved with block-Jacobi preconditioned conjugate gradients, a few iterations per step.
+// Sleeping and removed bubbles are fixed: they keep their velocity and only load their partners.
+class ImplicitContactSolver {
+public:
+    ImplicitContactSolver();
+
+    // Contacts of the current step, added by the pair pass for every pair that got a spring response
+    void clear() { contacts.clear(); }
+    void addContact(int a, int b, glm::vec2 normal);
+    size_t getContactCount() const { return contacts.size(); }
+
+    // Velocity change of every bubble over dt, index aligned with the store
+    const glm::vec2* solve(const BubbleStore& bubbles, float dt);
+
+    void setMaxIterations(int iterations) { max_iterations = iterations > 0 ? iterations : 1; }
+    int getMaxIterations() const { return max_iterations; }
+    int getLastIterations() const { return last_iterations; }
+    float getLastResidual() const { return last_residual; } // Relative to the right hand side
+
+private:
+    struct Contact {
+        int a;
+        int b;
+        glm::vec2 normal; // From a to b
+    };
+    std::vector<Contact> contacts;
+
+    int max_iterations;
+    int last_iterations;
+    float last_residual;
+
+    // Per bubble, all scratch for the solve
+    std::vector<char> free_bubble;        // 0 for sleeping and removed bubbles
+    std::vector<glm::vec2> velocity_change;
+    std::vector<glm::vec2> residual;
+    std::vector<glm::vec2> direction;
+    std::vector<glm::vec2> preconditioned;
+    std::vector<glm::vec2> product;
+    std::vector<glm::mat2> inverse_diagonal; // Inverse of each 2x2 diagonal block
+
+    void multiply(const std::vector<glm::vec2>& x, std::vector<glm::vec2>& result, const float* masses, float coupling) const;
+    void precondition();
+    float dot(const std::vector<glm::vec2>& a, const std::vector<glm::vec2>& b) const;
+};
+
+#endif
@@ -9,6 +9,8 @@
 #include <iostream>
 #include <vector>
 #include <chrono>
+#include <cstring>
+#include <cstdlib>
 
 // Simulation components
 #include "Bubble.h"
@@ -18,6 +20,8 @@
 #include "BubbleSimulator.h"
 #include "Surface2D.h" 
 #include "SimulationConstants.h"
+#include "VerletList.h"
+#include "SimulationClock.h"
 #define GLM_ENABLE_EXPERIMENTAL
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -33,8 +37,19 @@ BubbleSimulator* simulator_ptr = nullptr;
 double lastUpdateTime = 0.0;
 double lastRenderTime = 0.0;
 
-int main()
+int main(int argc, char** argv)
 {
+    // Step features, e.g. "--no-fusion --lift", and "--fluid-budget 1.5" to cap the fluid update at 1.5 ms
+    SimulationFeatures features = DEFAULT_SIMULATION_FEATURES;
+    float fluid_budget_ms = FLUID_STEP_BUDGET_MS;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--no-fusion") == 0) features.fusion = false;
+        else if (strcmp(argv[i], "--no-adhesion") == 0) features.adhesion = false;
+        else if (strcmp(argv[i], "--no-coupling") == 0) features.two_way_coupling = false;
+        else if (strcmp(argv[i], "--lift") == 0) features.lift = true;
+        else if (strcmp(argv[i], "--fluid-budget") == 0 && i + 1 < argc) fluid_budget_ms = static_cast<float>(atof(argv[++i]));
+    }
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -61,7 +76,11 @@ int main()
     BubbleRenderer renderer(bubbleShader, bubbleTexID);
     BubbleGenerator generator;
     BubbleSimulator simulator(SCR_WIDTH, SCR_HEIGHT);
+    SimulationClock simulation_clock(SIMULATION_STEP, SIMULATION_MAX_SUBSTEPS);
     simulator_ptr = &simulator; // For callback if needed to update fluid grid size
+    simulator.setFeatures(features);
+    simulator.getFluidGrid().setSolver(FluidSolver::StableFluids); // Wakes behind rising bubbles
+    simulator.getFluidGrid().setStepBudget(fluid_budget_ms);
 
     // Define some surfaces for interaction and generation
     // 
@@ -116,6 +135,27 @@ int main()
             printf("-> Simulation: %.2f ms (%.1f%%)\n", avgSimTime, (avgSimTime / avgFrameTime) * 100.0);
             printf("-> Rendering:  %.2f ms (%.1f%%)\n", avgRenderTime, (avgRenderTime / avgFrameTime) * 100.0);
             printf("-> Other/Overhead: %.2f ms\n", avgFrameTime - avgSimTime - avgRenderTime);
+            printf("Bubbles: %zu of %zu (%zu sleeping, %zu held in the slow lane)  |  Broadphase: %s\n", generator.bubbles.size(),
+                generator.bubbles.getCapacity(), simulator.getSleepingCount(), simulator.getHeldCount(),
+                getBroadphaseName(simulator.getBroadphaseMode()));
+            printf("Pool full: %s, %zu spawns rejected, %zu bubbles recycled\n", getSpawnPolicyName(generator.getSpawnPolicy()),
+                generator.getRejectedCount(), generator.getRecycledCount());
+            printf("Step: %.2f ms adaptive, limited by %s (%s), %d substeps last frame, %.2f s dropped by the %d substep cap\n",
+                simulation_clock.getFixedStep() * 1000.0f, getStepLimitName(simulator.getLastStepLimit()),
+                getIntegrationModeName(simulator.getIntegrationMode()),
+                simulation_clock.getLastSubsteps(), simulation_clock.getDroppedTime(), simulation_clock.getMaxSubsteps());
+            const FluidSolveStats& fluid = simulator.getFluidGrid().getLastSolveStats();
+            printf("Fluid: %s, %.2f ms, %d %s pressure iterations, residual %.1e%s\n", getFluidSolverName(simulator.getFluidGrid().getSolver()),
+                fluid.milliseconds, fluid.iterations, getPoissonMethodName(simulator.getFluidGrid().getPressureMethod()),
+                fluid.residual, fluid.over_budget ? " (over budget)" : "");
+            const ContactManager& contacts = simulator.getContactManager();
+            printf("Contacts: %zu active (%zu began, %zu ended last step)\n",
+                contacts.getContacts().size(), contacts.getBeginCount(), contacts.getEndCount());
+            if (const VerletList* verlet = dynamic_cast<const VerletList*>(&simulator.getBroadphase())) {
+                const VerletListStats& stats = verlet->getStats();
+                printf("-> Verlet lists: rebuilt %.0f%% of steps, %.1f neighbours per bubble (max %d)\n",
+                    stats.getRebuildRate() * 100.0f, stats.average_list_size, stats.max_list_size);
+            }
 
             lastFpsTime = currentTime;
         }
@@ -126,11 +166,18 @@ int main()
 
         // --- Simulation ---
         auto simStart = glfwGetTime();
-        // 1. Try to generate new bubbles
-        generator.tryGenerateBubbles(simulator.getSurfaces(), dt, static_cast<float>(SCR_WIDTH), static_cast<float>(SCR_HEIGHT));
-
-        // 2. Update all bubbles
-        simulator.update(dt, generator.bubbles);
+        // Step size from the current state, long while calm and short during bursts.
+        // Fixed steps of that size for the time that passed, the remainder waits for the next frame
+        simulation_clock.setFixedStep(simulator.computeStableStep(generator.bubbles));
+        const int substeps = simulation_clock.advance(dt);
+        const float step = simulation_clock.getFixedStep();
+        for (int s = 0; s < substeps; ++s) {
+            // 1. Try to generate new bubbles
+            generator.tryGenerateBubbles(simulator.getSurfaces(), step, static_cast<float>(SCR_WIDTH), static_cast<float>(SCR_HEIGHT));
+
+            // 2. Update all bubbles
+            simulator.update(step, generator.bubbles);
+        }
 
         lastUpdateTime = glfwGetTime() - simStart;
 
@@ -148,7 +195,8 @@ int main()
         // Render fluid grid velocities (for debugging)
         // simulator.getFluidGrid().drawGridVelocities();
 
-        renderer.renderBubbles(generator.bubbles);
+        // Between the last two steps, by how far the clock is into the next one
+        renderer.renderBubbles(generator.bubbles, simulation_clock.getAlpha());
         lastRenderTime = glfwGetTime() - renderStart;
 
         glfwSwapBuffers(window);
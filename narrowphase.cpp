@@ -0,0 +1,283 @@
+#include "Narrowphase.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#elif defined(SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+const char* getNarrowphaseName(NarrowphaseMode mode) {
+    switch (mode) {
+    case NarrowphaseMode::Sequential: return "Sequential";
+    case NarrowphaseMode::Batched: return "Batched";
+    }
+    return "Unknown";
+}
+
+void PairDeltas::resize(size_t count) {
+    normal_x.resize(count);
+    normal_y.resize(count);
+    penetration.resize(count);
+    force_x.resize(count);
+    force_y.resize(count);
+    correction_ax.resize(count);
+    correction_ay.resize(count);
+    correction_bx.resize(count);
+    correction_by.resize(count);
+}
+
+// BubbleStore arrays read by the kernels
+struct PackedBubbles {
+    const glm::vec2* position;
+    const glm::vec2* velocity;
+    const float* radius;
+    const float* mass;
+};
+
+// Reference kernel. Same operations in the same order as resolveBubblePair, the SIMD kernels
+// follow it lane by lane.
+static void computeDeltasScalar(const PackedBubbles& in, const BubblePair* pairs, size_t begin, size_t end, PairDeltas& out) {
+    for (size_t p = begin; p < end; ++p) {
+        const int a = pairs[p].a;
+        const int b = pairs[p].b;
+        float dx = in.position[b].x - in.position[a].x;
+        float dy = in.position[b].y - in.position[a].y;
+        float dist_sq = dx * dx + dy * dy;
+        float sum_radii = in.radius[a] + in.radius[b];
+
+        out.force_x[p] = 0.0f;
+        out.force_y[p] = 0.0f;
+        out.correction_ax[p] = 0.0f;
+        out.correction_ay[p] = 0.0f;
+        out.correction_bx[p] = 0.0f;
+        out.correction_by[p] = 0.0f;
+        if (dist_sq <= 0.0001f) {
+            out.normal_x[p] = 0.0f;
+            out.normal_y[p] = 0.0f;
+            out.penetration[p] = NARROWPHASE_DEGENERATE_PENETRATION;
+            continue;
+        }
+
+        float dist = std::sqrt(dist_sq);
+        float nx = dx / dist;
+        float ny = dy / dist;
+        float penetration = sum_radii - dist;
+        out.normal_x[p] = nx;
+        out.normal_y[p] = ny;
+        out.penetration[p] = penetration;
+        if (dist_sq >= sum_radii * sum_radii) continue;
+
+        // Spring and damping on a, along -normal
+        float spring_x = (-nx * penetration) * BUBBLE_COLLISION_STIFFNESS;
+        float spring_y = (-ny * penetration) * BUBBLE_COLLISION_STIFFNESS;
+        float relative_vx = in.velocity[a].x - in.velocity[b].x;
+        float relative_vy = in.velocity[a].y - in.velocity[b].y;
+        float v_n = relative_vx * -nx + relative_vy * -ny;
+        float damping = -BUBBLE_COLLISION_DAMPING * v_n;
+        out.force_x[p] = spring_x + -nx * damping;
+        out.force_y[p] = spring_y + -ny * damping;
+
+        // Half the penetration, split by mass
+        float correction_x = (nx * penetration) * 0.5f;
+        float correction_y = (ny * penetration) * 0.5f;
+        float total_mass = in.mass[a] + in.mass[b];
+        float share_a = in.mass[b] / total_mass;
+        float share_b = in.mass[a] / total_mass;
+        out.correction_ax[p] = -(correction_x * share_a);
+        out.correction_ay[p] = -(correction_y * share_a);
+        out.correction_bx[p] = correction_x * share_b;
+        out.correction_by[p] = correction_y * share_b;
+    }
+}
+
+#if defined(SIMD_X86)
+// 8 pairs per iteration, returns the first pair it left for the scalar kernel.
+// Positions and velocities are (x, y) pairs, so their gathers use an 8 byte scale.
+SIMD_AVX2_TARGET
+static size_t computeDeltasAvx2(const PackedBubbles& in, const BubblePair* pairs, size_t begin, size_t end, PairDeltas& out) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 min_dist_sq = _mm256_set1_ps(0.0001f);
+    const __m256 degenerate = _mm256_set1_ps(NARROWPHASE_DEGENERATE_PENETRATION);
+    const __m256 stiffness = _mm256_set1_ps(BUBBLE_COLLISION_STIFFNESS);
+    const __m256 neg_damping = _mm256_set1_ps(-BUBBLE_COLLISION_DAMPING);
+    // Splits interleaved (a, b) pairs into a in the low half and b in the high half
+    const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    size_t p = begin;
+    for (; p + 8 <= end; p += 8) {
+        __m256i pairs_lo = _mm256_permutevar8x32_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pairs + p)), deinterleave);
+        __m256i pairs_hi = _mm256_permutevar8x32_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pairs + p + 4)), deinterleave);
+        __m256i index_a = _mm256_permute2x128_si256(pairs_lo, pairs_hi, 0x20);
+        __m256i index_b = _mm256_permute2x128_si256(pairs_lo, pairs_hi, 0x31);
+
+        __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(&in.position->x, index_b, 8), _mm256_i32gather_ps(&in.position->x, index_a, 8));
+        __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(&in.position->y, index_b, 8), _mm256_i32gather_ps(&in.position->y, index_a, 8));
+        __m256 dist_sq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 sum_radii = _mm256_add_ps(_mm256_i32gather_ps(in.radius, index_a, 4), _mm256_i32gather_ps(in.radius, index_b, 4));
+
+        __m256 valid = _mm256_cmp_ps(dist_sq, min_dist_sq, _CMP_GT_OQ);
+        __m256 overlapping = _mm256_and_ps(valid, _mm256_cmp_ps(dist_sq, _mm256_mul_ps(sum_radii, sum_radii), _CMP_LT_OQ));
+
+        __m256 dist = _mm256_sqrt_ps(dist_sq);
+        __m256 nx = _mm256_div_ps(dx, dist);
+        __m256 ny = _mm256_div_ps(dy, dist);
+        __m256 penetration = _mm256_sub_ps(sum_radii, dist);
+        __m256 neg_nx = _mm256_xor_ps(nx, sign);
+        __m256 neg_ny = _mm256_xor_ps(ny, sign);
+
+        __m256 spring_x = _mm256_mul_ps(_mm256_mul_ps(neg_nx, penetration), stiffness);
+        __m256 spring_y = _mm256_mul_ps(_mm256_mul_ps(neg_ny, penetration), stiffness);
+        __m256 relative_vx = _mm256_sub_ps(_mm256_i32gather_ps(&in.velocity->x, index_a, 8), _mm256_i32gather_ps(&in.velocity->x, index_b, 8));
+        __m256 relative_vy = _mm256_sub_ps(_mm256_i32gather_ps(&in.velocity->y, index_a, 8), _mm256_i32gather_ps(&in.velocity->y, index_b, 8));
+        __m256 v_n = _mm256_add_ps(_mm256_mul_ps(relative_vx, neg_nx), _mm256_mul_ps(relative_vy, neg_ny));
+        __m256 damping = _mm256_mul_ps(neg_damping, v_n);
+        __m256 force_x = _mm256_add_ps(spring_x, _mm256_mul_ps(neg_nx, damping));
+        __m256 force_y = _mm256_add_ps(spring_y, _mm256_mul_ps(neg_ny, damping));
+
+        __m256 correction_x = _mm256_mul_ps(_mm256_mul_ps(nx, penetration), half);
+        __m256 correction_y = _mm256_mul_ps(_mm256_mul_ps(ny, penetration), half);
+        __m256 mass_a = _mm256_i32gather_ps(in.mass, index_a, 4);
+        __m256 mass_b = _mm256_i32gather_ps(in.mass, index_b, 4);
+        __m256 total_mass = _mm256_add_ps(mass_a, mass_b);
+        __m256 share_a = _mm256_div_ps(mass_b, total_mass);
+        __m256 share_b = _mm256_div_ps(mass_a, total_mass);
+
+        // Degenerate lanes may hold inf/nan, the masks replace them
+        _mm256_storeu_ps(&out.normal_x[p], _mm256_blendv_ps(zero, nx, valid));
+        _mm256_storeu_ps(&out.normal_y[p], _mm256_blendv_ps(zero, ny, valid));
+        _mm256_storeu_ps(&out.penetration[p], _mm256_blendv_ps(degenerate, penetration, valid));
+        _mm256_storeu_ps(&out.force_x[p], _mm256_and_ps(force_x, overlapping));
+        _mm256_storeu_ps(&out.force_y[p], _mm256_and_ps(force_y, overlapping));
+        _mm256_storeu_ps(&out.correction_ax[p], _mm256_and_ps(_mm256_xor_ps(_mm256_mul_ps(correction_x, share_a), sign), overlapping));
+        _mm256_storeu_ps(&out.correction_ay[p], _mm256_and_ps(_mm256_xor_ps(_mm256_mul_ps(correction_y, share_a), sign), overlapping));
+        _mm256_storeu_ps(&out.correction_bx[p], _mm256_and_ps(_mm256_mul_ps(correction_x, share_b), overlapping));
+        _mm256_storeu_ps(&out.correction_by[p], _mm256_and_ps(_mm256_mul_ps(correction_y, share_b), overlapping));
+    }
+    return p;
+}
+#endif
+
+#if defined(SIMD_NEON)
+// 4 pairs per iteration, NEON has no gathers so lanes are loaded through small arrays
+static size_t computeDeltasNeon(const PackedBubbles& in, const BubblePair* pairs, size_t begin, size_t end, PairDeltas& out) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t degenerate = vdupq_n_f32(NARROWPHASE_DEGENERATE_PENETRATION);
+
+    size_t p = begin;
+    for (; p + 4 <= end; p += 4) {
+        float lanes[12][4];
+        for (int lane = 0; lane < 4; ++lane) {
+            const int a = pairs[p + lane].a;
+            const int b = pairs[p + lane].b;
+            lanes[0][lane] = in.position[a].x;
+            lanes[1][lane] = in.position[a].y;
+            lanes[2][lane] = in.position[b].x;
+            lanes[3][lane] = in.position[b].y;
+            lanes[4][lane] = in.velocity[a].x;
+            lanes[5][lane] = in.velocity[a].y;
+            lanes[6][lane] = in.velocity[b].x;
+            lanes[7][lane] = in.velocity[b].y;
+            lanes[8][lane] = in.radius[a];
+            lanes[9][lane] = in.radius[b];
+            lanes[10][lane] = in.mass[a];
+            lanes[11][lane] = in.mass[b];
+        }
+
+        float32x4_t dx = vsubq_f32(vld1q_f32(lanes[2]), vld1q_f32(lanes[0]));
+        float32x4_t dy = vsubq_f32(vld1q_f32(lanes[3]), vld1q_f32(lanes[1]));
+        float32x4_t dist_sq = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+        float32x4_t sum_radii = vaddq_f32(vld1q_f32(lanes[8]), vld1q_f32(lanes[9]));
+
+        uint32x4_t valid = vcgtq_f32(dist_sq, vdupq_n_f32(0.0001f));
+        uint32x4_t overlapping = vandq_u32(valid, vcltq_f32(dist_sq, vmulq_f32(sum_radii, sum_radii)));
+
+        float32x4_t dist = vsqrtq_f32(dist_sq);
+        float32x4_t nx = vdivq_f32(dx, dist);
+        float32x4_t ny = vdivq_f32(dy, dist);
+        float32x4_t penetration = vsubq_f32(sum_radii, dist);
+        float32x4_t neg_nx = vnegq_f32(nx);
+        float32x4_t neg_ny = vnegq_f32(ny);
+
+        float32x4_t spring_x = vmulq_n_f32(vmulq_f32(neg_nx, penetration), BUBBLE_COLLISION_STIFFNESS);
+        float32x4_t spring_y = vmulq_n_f32(vmulq_f32(neg_ny, penetration), BUBBLE_COLLISION_STIFFNESS);
+        float32x4_t relative_vx = vsubq_f32(vld1q_f32(lanes[4]), vld1q_f32(lanes[6]));
+        float32x4_t relative_vy = vsubq_f32(vld1q_f32(lanes[5]), vld1q_f32(lanes[7]));
+        float32x4_t v_n = vaddq_f32(vmulq_f32(relative_vx, neg_nx), vmulq_f32(relative_vy, neg_ny));
+        float32x4_t damping = vmulq_n_f32(v_n, -BUBBLE_COLLISION_DAMPING);
+        float32x4_t force_x = vaddq_f32(spring_x, vmulq_f32(neg_nx, damping));
+        float32x4_t force_y = vaddq_f32(spring_y, vmulq_f32(neg_ny, damping));
+
+        float32x4_t correction_x = vmulq_n_f32(vmulq_f32(nx, penetration), 0.5f);
+        float32x4_t correction_y = vmulq_n_f32(vmulq_f32(ny, penetration), 0.5f);
+        float32x4_t mass_a = vld1q_f32(lanes[10]);
+        float32x4_t mass_b = vld1q_f32(lanes[11]);
+        float32x4_t total_mass = vaddq_f32(mass_a, mass_b);
+        float32x4_t share_a = vdivq_f32(mass_b, total_mass);
+        float32x4_t share_b = vdivq_f32(mass_a, total_mass);
+
+        vst1q_f32(&out.normal_x[p], vbslq_f32(valid, nx, zero));
+        vst1q_f32(&out.normal_y[p], vbslq_f32(valid, ny, zero));
+        vst1q_f32(&out.penetration[p], vbslq_f32(valid, penetration, degenerate));
+        vst1q_f32(&out.force_x[p], vbslq_f32(overlapping, force_x, zero));
+        vst1q_f32(&out.force_y[p], vbslq_f32(overlapping, force_y, zero));
+        vst1q_f32(&out.correction_ax[p], vbslq_f32(overlapping, vnegq_f32(vmulq_f32(correction_x, share_a)), zero));
+        vst1q_f32(&out.correction_ay[p], vbslq_f32(overlapping, vnegq_f32(vmulq_f32(correction_y, share_a)), zero));
+        vst1q_f32(&out.correction_bx[p], vbslq_f32(overlapping, vmulq_f32(correction_x, share_b), zero));
+        vst1q_f32(&out.correction_by[p], vbslq_f32(overlapping, vmulq_f32(correction_y, share_b), zero));
+    }
+    return p;
+}
+#endif
+
+Narrowphase::Narrowphase()
+    : simd_level(detectSimdLevel()) {
+}
+
+void Narrowphase::setSimdLevel(SimdLevel level) {
+    simd_level = level == detectSimdLevel() ? level : SimdLevel::Scalar;
+}
+
+static void computeDeltasRange(SimdLevel level, const PackedBubbles& packed, const BubblePair* pairs, size_t begin, size_t end, PairDeltas& deltas) {
+    size_t done = begin;
+    switch (level) {
+#if defined(SIMD_X86)
+    case SimdLevel::Avx2:
+        done = computeDeltasAvx2(packed, pairs, begin, end, deltas);
+        break;
+#endif
+#if defined(SIMD_NEON)
+    case SimdLevel::Neon:
+        done = computeDeltasNeon(packed, pairs, begin, end, deltas);
+        break;
+#endif
+    default:
+        break;
+    }
+    computeDeltasScalar(packed, pairs, done, end, deltas);
+}
+
+void Narrowphase::computeDeltas(const BubbleStore& bubbles, const std::vector<BubblePair>& pairs, PairDeltas& deltas,
+    ThreadPool* threadPool) {
+    deltas.resize(pairs.size());
+    if (pairs.empty()) return;
+
+    const PackedBubbles packed = { bubbles.getPositions(), bubbles.getVelocities(), bubbles.getRadii(), bubbles.getMasses() };
+    if (!threadPool) {
+        computeDeltasRange(simd_level, packed, pairs.data(), 0, pairs.size(), deltas);
+        return;
+    }
+
+    // Blocks of 8 pairs, so only the last block can fall back to the scalar kernel
+    const size_t pair_count = pairs.size();
+    const size_t block_count = (pair_count + 7) / 8;
+    const SimdLevel level = simd_level;
+    threadPool->parallelFor(block_count, 256, [&](size_t begin, size_t end) {
+        computeDeltasRange(level, packed, pairs.data(), begin * 8, std::min(end * 8, pair_count), deltas);
+    });
+}
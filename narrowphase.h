@@ -0,0 +1,58 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include <vector>
+#include "BubbleStore.h"
+#include "Broadphase.h"
+#include "ThreadPool.h"
+#include "Simd.h"
+
+// How candidate pairs are resolved.
+enum class NarrowphaseMode {
+    Sequential, // One pair at a time in pair order, each sees the corrections of the pairs before it
+    Batched     // All pairs from the same state with the SIMD kernel, summed per bubble on the thread pool
+};
+
+const char* getNarrowphaseName(NarrowphaseMode mode);
+
+// Spring/damping response of each candidate pair, one entry per pair, kept as separate arrays so
+// the SIMD kernels can store whole lanes.
+struct PairDeltas {
+    std::vector<float> normal_x;      // Unit normal from a to b
+    std::vector<float> normal_y;
+    std::vector<float> penetration;   // Sum of radii minus distance, negative while apart
+    std::vector<float> force_x;       // Force on a, b gets the opposite
+    std::vector<float> force_y;
+    std::vector<float> correction_ax; // Position correction of a, split by mass
+    std::vector<float> correction_ay;
+    std::vector<float> correction_bx; // Position correction of b
+    std::vector<float> correction_by;
+
+    void resize(size_t count);
+    size_t size() const { return penetration.size(); }
+};
+
+// Penetration written for pairs too close to have a normal, they get no response and no contact
+const float NARROWPHASE_DEGENERATE_PENETRATION = -1.0e30f;
+
+// Batched circle-circle narrowphase. The kernel gathers both bubbles of several pairs at a time
+// straight from the BubbleStore arrays and writes their PairDeltas.
+// Overlapping pairs get the same spring, damping and half-penetration correction as
+// BubbleSimulator::resolveBubblePair; other pairs only get their normal and penetration.
+class Narrowphase {
+public:
+    Narrowphase();
+
+    // Each pair writes only its own entry, so the pool can split pairs freely (in blocks of 8)
+    void computeDeltas(const BubbleStore& bubbles, const std::vector<BubblePair>& pairs, PairDeltas& deltas,
+        ThreadPool* threadPool = nullptr);
+
+    // Forces a kernel, e.g. the scalar one as a reference. Unsupported levels fall back to scalar.
+    void setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel() const { return simd_level; }
+
+private:
+    SimdLevel simd_level;
+};
+
+#endif
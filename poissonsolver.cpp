@@ -0,0 +1,591 @@
+#include "PoissonSolver.h"
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+const char* getPoissonMethodName(PoissonMethod method) {
+    switch (method) {
+    case PoissonMethod::GaussSeidel: return "Gauss-Seidel";
+    case PoissonMethod::Multigrid: return "Multigrid";
+    case PoissonMethod::MultigridCG: return "Multigrid CG";
+    }
+    return "Unknown";
+}
+
+PoissonSolver::PoissonSolver(int width, int height)
+    : cg_previous_rz(0.0),
+    method(PoissonMethod::MultigridCG),
+    hierarchy_valid(false),
+    last_iterations(0),
+    last_residual(0.0f),
+    over_budget(false) {
+    grid.width = width;
+    grid.height = height;
+    grid.stride = width + 2;
+    const size_t size = static_cast<size_t>(grid.stride) * (height + 2);
+    grid.solution.assign(size, 0.0f);
+    grid.rhs.assign(size, 0.0f);
+    grid.residual.assign(size, 0.0f);
+    grid.open.assign(size, 0.0f);
+    grid.weight_x.assign(size, 0.0f);
+    grid.weight_y.assign(size, 0.0f);
+    grid.diagonal.assign(size, 0.0f);
+    grid.inverse_diagonal.assign(size, 0.0f);
+    cg_solution.assign(size, 0.0f);
+    cg_residual.assign(size, 0.0f);
+    cg_direction.assign(size, 0.0f);
+    cg_product.assign(size, 0.0f);
+    cg_previous.assign(size, 0.0f);
+    problem_rhs.assign(size, 0.0f);
+    clearSolids();
+}
+
+void PoissonSolver::setSolid(int x, int y, bool solid) {
+    if (x < 0 || x >= grid.width || y < 0 || y >= grid.height) return;
+    grid.open[grid.getIndex(x, y)] = solid ? 0.0f : 1.0f;
+    hierarchy_valid = false;
+}
+
+void PoissonSolver::addSurface(const Surface2D& surface, float cellSize) {
+    // Cells whose center is within half a cell diagonal of the segment
+    const float reach = 0.5f * cellSize * std::sqrt(2.0f);
+    const glm::vec2 low = glm::min(surface.start_point, surface.end_point) - glm::vec2(reach);
+    const glm::vec2 high = glm::max(surface.start_point, surface.end_point) + glm::vec2(reach);
+    const int x_begin = std::max(0, static_cast<int>(std::floor(low.x / cellSize)));
+    const int y_begin = std::max(0, static_cast<int>(std::floor(low.y / cellSize)));
+    const int x_end = std::min(getWidth() - 1, static_cast<int>(std::floor(high.x / cellSize)));
+    const int y_end = std::min(getHeight() - 1, static_cast<int>(std::floor(high.y / cellSize)));
+
+    const glm::vec2 line_vec = surface.end_point - surface.start_point;
+    const float length_sq = glm::dot(line_vec, line_vec);
+    for (int y = y_begin; y <= y_end; ++y) {
+        for (int x = x_begin; x <= x_end; ++x) {
+            glm::vec2 center((x + 0.5f) * cellSize, (y + 0.5f) * cellSize);
+            float t = length_sq > 0.0f ? glm::clamp(glm::dot(center - surface.start_point, line_vec) / length_sq, 0.0f, 1.0f) : 0.0f;
+            if (glm::length2(center - (surface.start_point + t * line_vec)) < reach * reach) setSolid(x, y, true);
+        }
+    }
+}
+
+void PoissonSolver::clearSolids() {
+    std::fill(grid.open.begin(), grid.open.end(), 0.0f);
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            grid.open[grid.getIndex(x, y)] = 1.0f;
+        }
+    }
+    hierarchy_valid = false;
+}
+
+int PoissonSolver::getLevelCount() {
+    if (!hierarchy_valid) buildHierarchy();
+    return 1 + static_cast<int>(levels.size());
+}
+
+void PoissonSolver::updateFaceWeights() {
+    // Faces past the grid edge stay 0
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            const int k = grid.getIndex(x, y);
+            grid.weight_x[k] = grid.open[k] * grid.open[k + 1];
+            grid.weight_y[k] = grid.open[k] * grid.open[k + grid.stride];
+        }
+    }
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            const int k = grid.getIndex(x, y);
+            grid.diagonal[k] = grid.weight_x[k - 1] + grid.weight_x[k] + grid.weight_y[k - grid.stride] + grid.weight_y[k];
+            grid.inverse_diagonal[k] = grid.diagonal[k] > 0.0f ? 1.0f / grid.diagonal[k] : 0.0f;
+        }
+    }
+}
+
+void PoissonSolver::SparseMatrix::transpose(int columnCount, SparseMatrix& out) const {
+    out.row_start.assign(columnCount + 1, 0);
+    for (int column : columns) {
+        out.row_start[column + 1]++;
+    }
+    for (int row = 0; row < columnCount; ++row) {
+        out.row_start[row + 1] += out.row_start[row];
+    }
+    out.columns.resize(columns.size());
+    out.values.resize(values.size());
+    std::vector<int> next(out.row_start.begin(), out.row_start.end() - 1);
+    for (int row = 0; row < getRowCount(); ++row) {
+        for (int e = row_start[row]; e < row_start[row + 1]; ++e) {
+            const int slot = next[columns[e]]++;
+            out.columns[slot] = row;
+            out.values[slot] = values[e];
+        }
+    }
+}
+
+// Row by row, each output row gathered in place (Gustavson)
+void PoissonSolver::multiply(const SparseMatrix& a, const SparseMatrix& b, int columnCount, SparseMatrix& out) {
+    out.row_start.assign(1, 0);
+    out.columns.clear();
+    out.values.clear();
+    std::vector<int> position(columnCount, -1); // Entry of the column in out, if it is in the current row
+    for (int row = 0; row < a.getRowCount(); ++row) {
+        const int row_begin = static_cast<int>(out.columns.size());
+        for (int e = a.row_start[row]; e < a.row_start[row + 1]; ++e) {
+            const int k = a.columns[e];
+            for (int f = b.row_start[k]; f < b.row_start[k + 1]; ++f) {
+                const int column = b.columns[f];
+                if (position[column] < row_begin) {
+                    position[column] = static_cast<int>(out.columns.size());
+                    out.columns.push_back(column);
+                    out.values.push_back(0.0f);
+                }
+                out.values[position[column]] += a.values[e] * b.values[f];
+            }
+        }
+        out.row_start.push_back(static_cast<int>(out.columns.size()));
+    }
+}
+
+// Every unknown with an operator row joins the group of its 3x3 block that it reaches through strong
+// couplings without leaving the block. Couplings through a wall are 0, so the wall splits the block.
+void PoissonSolver::aggregate(const SparseMatrix& matrix, const std::vector<int>& cellX, const std::vector<int>& cellY,
+    std::vector<int>& aggregates, std::vector<int>& aggregateX, std::vector<int>& aggregateY) {
+    const int count = matrix.getRowCount();
+    std::vector<float> diagonal(count, 0.0f);
+    for (int row = 0; row < count; ++row) {
+        for (int e = matrix.row_start[row]; e < matrix.row_start[row + 1]; ++e) {
+            if (matrix.columns[e] == row) diagonal[row] = matrix.values[e];
+        }
+    }
+
+    aggregates.assign(count, -1);
+    aggregateX.clear();
+    aggregateY.clear();
+    std::vector<int> queue;
+    for (int seed = 0; seed < count; ++seed) {
+        if (aggregates[seed] >= 0 || diagonal[seed] == 0.0f) continue;
+        const int id = static_cast<int>(aggregateX.size());
+        const int block_x = cellX[seed] / 3;
+        const int block_y = cellY[seed] / 3;
+        aggregateX.push_back(block_x);
+        aggregateY.push_back(block_y);
+        aggregates[seed] = id;
+        queue.assign(1, seed);
+        for (size_t next = 0; next < queue.size(); ++next) {
+            const int row = queue[next];
+            for (int e = matrix.row_start[row]; e < matrix.row_start[row + 1]; ++e) {
+                const int column = matrix.columns[e];
+                if (aggregates[column] >= 0 || diagonal[column] == 0.0f) continue;
+                if (cellX[column] / 3 != block_x || cellY[column] / 3 != block_y) continue;
+                if (std::abs(matrix.values[e]) < POISSON_STRONG_COUPLING * std::sqrt(diagonal[row] * diagonal[column])) continue;
+                aggregates[column] = id;
+                queue.push_back(column);
+            }
+        }
+    }
+}
+
+void PoissonSolver::buildHierarchy() {
+    updateFaceWeights();
+    levels.clear();
+
+    // The grid's operator as a matrix over storage indices, empty rows for solid and ghost cells
+    const int size = static_cast<int>(grid.solution.size());
+    const int s = grid.stride;
+    SparseMatrix grid_matrix;
+    std::vector<int> cell_x(size, 0);
+    std::vector<int> cell_y(size, 0);
+    grid_matrix.row_start.assign(1, 0);
+    for (int k = 0; k < size; ++k) {
+        cell_x[k] = k % s - 1;
+        cell_y[k] = k / s - 1;
+        if (grid.open[k] != 0.0f && grid.diagonal[k] > 0.0f) {
+            const int neighbours[4] = { k - s, k - 1, k + 1, k + s };
+            const float weights[4] = { grid.weight_y[k - s], grid.weight_x[k - 1], grid.weight_x[k], grid.weight_y[k] };
+            for (int n = 0; n < 4; ++n) {
+                if (weights[n] == 0.0f) continue;
+                grid_matrix.columns.push_back(neighbours[n]);
+                grid_matrix.values.push_back(weights[n]);
+            }
+            grid_matrix.columns.push_back(k);
+            grid_matrix.values.push_back(-grid.diagonal[k]);
+        }
+        grid_matrix.row_start.push_back(static_cast<int>(grid_matrix.columns.size()));
+    }
+
+    int width = grid.width;
+    int height = grid.height;
+    std::vector<int> aggregates;
+    std::vector<int> aggregate_x;
+    std::vector<int> aggregate_y;
+    std::vector<float> accumulator;
+    std::vector<int> position;
+    while (std::max(width, height) > POISSON_COARSEST_SIZE) {
+        const SparseMatrix& matrix = levels.empty() ? grid_matrix : levels.back().matrix;
+        aggregate(matrix, cell_x, cell_y, aggregates, aggregate_x, aggregate_y);
+        const int coarse_count = static_cast<int>(aggregate_x.size());
+        if (coarse_count == 0) break;
+
+        // Damping 4 / (3 rho) for the Jacobi step, rho bounded by the largest row sum of |D^-1 A|
+        const int count = matrix.getRowCount();
+        float rho = 1.0f;
+        for (int row = 0; row < count; ++row) {
+            float diagonal = 0.0f;
+            float row_sum = 0.0f;
+            for (int e = matrix.row_start[row]; e < matrix.row_start[row + 1]; ++e) {
+                if (matrix.columns[e] == row) diagonal = matrix.values[e];
+                row_sum += std::abs(matrix.values[e]);
+            }
+            if (diagonal != 0.0f) rho = std::max(rho, row_sum / std::abs(diagonal));
+        }
+        const float omega = 4.0f / (3.0f * rho);
+
+        // P = (I - omega D^-1 A) T, T the 0/1 indicator of the groups
+        CoarseLevel level;
+        SparseMatrix& prolongation = level.prolongation;
+        prolongation.row_start.assign(1, 0);
+        accumulator.assign(coarse_count, 0.0f);
+        position.assign(coarse_count, -1);
+        for (int row = 0; row < count; ++row) {
+            const int row_begin = static_cast<int>(prolongation.columns.size());
+            if (aggregates[row] >= 0) {
+                float diagonal = 0.0f;
+                for (int e = matrix.row_start[row]; e < matrix.row_start[row + 1]; ++e) {
+                    if (matrix.columns[e] == row) diagonal = matrix.values[e];
+                }
+                for (int e = matrix.row_start[row]; e < matrix.row_start[row + 1]; ++e) {
+                    const int group = aggregates[matrix.columns[e]];
+                    if (group < 0) continue;
+                    if (position[group] < row_begin) {
+                        position[group] = static_cast<int>(prolongation.columns.size());
+                        prolongation.columns.push_back(group);
+                        prolongation.values.push_back(0.0f);
+                    }
+                    prolongation.values[position[group]] -= omega * matrix.values[e] / diagonal;
+                }
+                // The identity part
+                if (position[aggregates[row]] < row_begin) {
+                    position[aggregates[row]] = static_cast<int>(prolongation.columns.size());
+                    prolongation.columns.push_back(aggregates[row]);
+                    prolongation.values.push_back(0.0f);
+                }
+                prolongation.values[position[aggregates[row]]] += 1.0f;
+            }
+            prolongation.row_start.push_back(static_cast<int>(prolongation.columns.size()));
+        }
+        prolongation.transpose(coarse_count, level.restriction);
+
+        SparseMatrix product;
+        multiply(matrix, prolongation, coarse_count, product);
+        multiply(level.restriction, product, coarse_count, level.matrix);
+        level.inverse_diagonal.assign(coarse_count, 0.0f);
+        for (int row = 0; row < coarse_count; ++row) {
+            for (int e = level.matrix.row_start[row]; e < level.matrix.row_start[row + 1]; ++e) {
+                if (level.matrix.columns[e] == row && level.matrix.values[e] != 0.0f) level.inverse_diagonal[row] = 1.0f / level.matrix.values[e];
+            }
+        }
+        level.solution.assign(coarse_count, 0.0f);
+        level.rhs.assign(coarse_count, 0.0f);
+        level.residual.assign(coarse_count, 0.0f);
+        levels.push_back(std::move(level));
+
+        cell_x = aggregate_x;
+        cell_y = aggregate_y;
+        width = (width + 2) / 3;
+        height = (height + 2) / 3;
+    }
+    hierarchy_valid = true;
+}
+
+// Red cells ((x + y) even), then black, or the other way round. Each half only reads the other,
+// so the order within a half doesn't matter.
+void PoissonSolver::smoothRedBlack(int sweeps, bool blackFirst) {
+    const int s = grid.stride;
+    float* p = grid.solution.data();
+    const float* f = grid.rhs.data();
+    const float* wx = grid.weight_x.data();
+    const float* wy = grid.weight_y.data();
+    const float* inverse = grid.inverse_diagonal.data();
+    for (int sweep = 0; sweep < sweeps; ++sweep) {
+        for (int half = 0; half < 2; ++half) {
+            const int color = blackFirst ? 1 - half : half;
+            for (int y = 0; y < grid.height; ++y) {
+                for (int x = (y + color) & 1; x < grid.width; x += 2) {
+                    const int k = grid.getIndex(x, y);
+                    p[k] = (wx[k - 1] * p[k - 1] + wx[k] * p[k + 1] + wy[k - s] * p[k - s] + wy[k] * p[k + s] - f[k]) * inverse[k];
+                }
+            }
+        }
+    }
+}
+
+float PoissonSolver::sweepGaussSeidel() {
+    const int s = grid.stride;
+    float* p = grid.solution.data();
+    const float* f = grid.rhs.data();
+    const float* o = grid.open.data();
+    const float* wx = grid.weight_x.data();
+    const float* wy = grid.weight_y.data();
+    const float* d = grid.diagonal.data();
+    const float* inverse = grid.inverse_diagonal.data();
+    float max_residual = 0.0f;
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            const int k = grid.getIndex(x, y);
+            const float neighbours = wx[k - 1] * p[k - 1] + wx[k] * p[k + 1] + wy[k - s] * p[k - s] + wy[k] * p[k + s];
+            max_residual = std::max(max_residual, std::abs(o[k] * (f[k] - (neighbours - d[k] * p[k]))));
+            p[k] = (neighbours - f[k]) * inverse[k];
+        }
+    }
+    return max_residual;
+}
+
+float PoissonSolver::computeResidual(const float* p, const float* rhs, float* r) const {
+    const int s = grid.stride;
+    const float* o = grid.open.data();
+    const float* wx = grid.weight_x.data();
+    const float* wy = grid.weight_y.data();
+    const float* d = grid.diagonal.data();
+    float max_residual = 0.0f;
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            const int k = grid.getIndex(x, y);
+            const float neighbours = wx[k - 1] * p[k - 1] + wx[k] * p[k + 1] + wy[k - s] * p[k - s] + wy[k] * p[k + s];
+            r[k] = o[k] * (rhs[k] - (neighbours - d[k] * p[k]));
+            max_residual = std::max(max_residual, std::abs(r[k]));
+        }
+    }
+    return max_residual;
+}
+
+void PoissonSolver::applyOperator(const float* p, float* out) const {
+    const int s = grid.stride;
+    const float* o = grid.open.data();
+    const float* wx = grid.weight_x.data();
+    const float* wy = grid.weight_y.data();
+    const float* d = grid.diagonal.data();
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            const int k = grid.getIndex(x, y);
+            out[k] = o[k] * (wx[k - 1] * p[k - 1] + wx[k] * p[k + 1] + wy[k - s] * p[k - s] + wy[k] * p[k + s] - d[k] * p[k]);
+        }
+    }
+}
+
+void PoissonSolver::smoothGaussSeidel(CoarseLevel& level, int sweeps, bool backward) {
+    const SparseMatrix& a = level.matrix;
+    const int count = a.getRowCount();
+    for (int sweep = 0; sweep < sweeps; ++sweep) {
+        for (int step = 0; step < count; ++step) {
+            const int row = backward ? count - 1 - step : step;
+            float residual = level.rhs[row];
+            for (int e = a.row_start[row]; e < a.row_start[row + 1]; ++e) {
+                residual -= a.values[e] * level.solution[a.columns[e]];
+            }
+            level.solution[row] += residual * level.inverse_diagonal[row];
+        }
+    }
+}
+
+void PoissonSolver::computeResidual(CoarseLevel& level) {
+    const SparseMatrix& a = level.matrix;
+    for (int row = 0; row < a.getRowCount(); ++row) {
+        float residual = level.rhs[row];
+        for (int e = a.row_start[row]; e < a.row_start[row + 1]; ++e) {
+            residual -= a.values[e] * level.solution[a.columns[e]];
+        }
+        level.residual[row] = residual;
+    }
+}
+
+// r_coarse = R r, x += P e
+static void restrictResidual(const std::vector<int>& rowStart, const std::vector<int>& columns, const std::vector<float>& values,
+    const float* residual, std::vector<float>& coarseRhs, std::vector<float>& coarseSolution) {
+    for (size_t row = 0; row + 1 < rowStart.size(); ++row) {
+        float sum = 0.0f;
+        for (int e = rowStart[row]; e < rowStart[row + 1]; ++e) {
+            sum += values[e] * residual[columns[e]];
+        }
+        coarseRhs[row] = sum;
+        coarseSolution[row] = 0.0f;
+    }
+}
+
+static void prolongCorrection(const std::vector<int>& rowStart, const std::vector<int>& columns, const std::vector<float>& values,
+    const std::vector<float>& correction, float* solution) {
+    for (size_t row = 0; row + 1 < rowStart.size(); ++row) {
+        float sum = 0.0f;
+        for (int e = rowStart[row]; e < rowStart[row + 1]; ++e) {
+            sum += values[e] * correction[columns[e]];
+        }
+        solution[row] += sum;
+    }
+}
+
+void PoissonSolver::vCycle() {
+    smoothRedBlack(POISSON_SMOOTHING_SWEEPS, false);
+    if (!levels.empty()) {
+        CoarseLevel& coarse = levels[0];
+        computeResidual(grid.solution.data(), grid.rhs.data(), grid.residual.data());
+        restrictResidual(coarse.restriction.row_start, coarse.restriction.columns, coarse.restriction.values,
+            grid.residual.data(), coarse.rhs, coarse.solution);
+        vCycle(0);
+        prolongCorrection(coarse.prolongation.row_start, coarse.prolongation.columns, coarse.prolongation.values,
+            coarse.solution, grid.solution.data());
+    }
+    smoothRedBlack(POISSON_SMOOTHING_SWEEPS, true);
+}
+
+void PoissonSolver::vCycle(size_t index) {
+    CoarseLevel& level = levels[index];
+    if (index + 1 == levels.size()) {
+        // Neumann problem: keep the right hand side compatible, float error would make it drift.
+        // Constants are the operator's null space on every level, so the plain mean goes.
+        if (!level.rhs.empty()) {
+            float sum = 0.0f;
+            for (float value : level.rhs) {
+                sum += value;
+            }
+            const float mean = sum / level.rhs.size();
+            for (float& value : level.rhs) {
+                value -= mean;
+            }
+        }
+        smoothGaussSeidel(level, POISSON_COARSEST_SWEEPS / 2, false);
+        smoothGaussSeidel(level, POISSON_COARSEST_SWEEPS / 2, true);
+        return;
+    }
+
+    CoarseLevel& coarse = levels[index + 1];
+    smoothGaussSeidel(level, POISSON_SMOOTHING_SWEEPS, false);
+    computeResidual(level);
+    restrictResidual(coarse.restriction.row_start, coarse.restriction.columns, coarse.restriction.values,
+        level.residual.data(), coarse.rhs, coarse.solution);
+    vCycle(index + 1);
+    prolongCorrection(coarse.prolongation.row_start, coarse.prolongation.columns, coarse.prolongation.values,
+        coarse.solution, level.solution.data());
+    smoothGaussSeidel(level, POISSON_SMOOTHING_SWEEPS, true);
+}
+
+// Preconditioned CG with the Polak-Ribiere beta, which tolerates a preconditioner that is not
+// exactly symmetric in float. Sums run in double, a few hundred thousand float terms lose too much otherwise.
+float PoissonSolver::iterateMultigridCG(bool first) {
+    const size_t size = grid.solution.size();
+
+    // Preconditioned residual z = V-cycle(r) from a zero guess
+    for (size_t k = 0; k < size; ++k) {
+        grid.rhs[k] = cg_residual[k];
+        grid.solution[k] = 0.0f;
+    }
+    vCycle();
+    const float* z = grid.solution.data();
+
+    double rz = 0.0;
+    double r_previous_z = 0.0;
+    for (size_t k = 0; k < size; ++k) {
+        rz += static_cast<double>(cg_residual[k]) * z[k];
+        r_previous_z += static_cast<double>(cg_residual[k]) * cg_previous[k];
+    }
+    const float beta = first || cg_previous_rz == 0.0 ? 0.0f : static_cast<float>((rz - r_previous_z) / cg_previous_rz);
+    for (size_t k = 0; k < size; ++k) {
+        cg_direction[k] = z[k] + beta * cg_direction[k];
+        cg_previous[k] = z[k];
+    }
+    cg_previous_rz = rz;
+
+    applyOperator(cg_direction.data(), cg_product.data());
+    double direction_product = 0.0;
+    for (size_t k = 0; k < size; ++k) {
+        direction_product += static_cast<double>(cg_direction[k]) * cg_product[k];
+    }
+    // The operator and the V-cycle are both negative semidefinite, rz and direction_product are <= 0
+    const float alpha = direction_product < 0.0 ? static_cast<float>(rz / direction_product) : 0.0f;
+
+    float max_residual = 0.0f;
+    for (size_t k = 0; k < size; ++k) {
+        cg_solution[k] += alpha * cg_direction[k];
+        cg_residual[k] -= alpha * cg_product[k];
+        max_residual = std::max(max_residual, std::abs(cg_residual[k]));
+    }
+    return max_residual;
+}
+
+int PoissonSolver::solve(float* solution, const float* rhs, int rowStride, int maxIterations, float tolerance, float budgetMs) {
+    auto start = std::chrono::steady_clock::now();
+    if (!hierarchy_valid) buildHierarchy();
+
+    float max_rhs = 0.0f;
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            const int k = grid.getIndex(x, y);
+            grid.solution[k] = grid.open[k] * solution[y * rowStride + x];
+            grid.rhs[k] = grid.open[k] * rhs[y * rowStride + x];
+            max_rhs = std::max(max_rhs, std::abs(grid.rhs[k]));
+        }
+    }
+
+    last_iterations = 0;
+    last_residual = 0.0f;
+    over_budget = false;
+    const bool conjugate_gradients = method == PoissonMethod::MultigridCG;
+    if (max_rhs > 0.0f) {
+        if (conjugate_gradients) {
+            problem_rhs = grid.rhs;
+            cg_solution = grid.solution;
+            computeResidual(cg_solution.data(), problem_rhs.data(), cg_residual.data());
+        }
+        bool restart = true;
+        for (int iteration = 0; iteration < maxIterations; ++iteration) {
+            float max_residual;
+            if (method == PoissonMethod::Multigrid) {
+                vCycle();
+                max_residual = computeResidual(grid.solution.data(), grid.rhs.data(), grid.residual.data());
+            }
+            else if (conjugate_gradients) {
+                max_residual = iterateMultigridCG(restart);
+                restart = false;
+                if (max_residual <= tolerance * max_rhs) {
+                    // The updated residual drifts from the true one in float. Only the true one may stop
+                    // the solve; if it is not there yet, CG starts over from it.
+                    max_residual = computeResidual(cg_solution.data(), problem_rhs.data(), cg_residual.data());
+                    restart = true;
+                }
+            }
+            else {
+                max_residual = sweepGaussSeidel();
+            }
+            last_iterations = iteration + 1;
+            last_residual = max_residual / max_rhs;
+            if (last_residual <= tolerance) break;
+            if (budgetMs > 0.0f && std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() > budgetMs) {
+                over_budget = iteration + 1 < maxIterations;
+                break;
+            }
+        }
+        if (conjugate_gradients) {
+            grid.solution = cg_solution;
+            last_residual = computeResidual(grid.solution.data(), problem_rhs.data(), grid.residual.data()) / max_rhs;
+        }
+    }
+
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            solution[y * rowStride + x] = grid.solution[grid.getIndex(x, y)];
+        }
+    }
+    return last_iterations;
+}
+
+float PoissonSolver::computeResidual(const float* solution, const float* rhs, int rowStride) {
+    if (!hierarchy_valid) buildHierarchy();
+    float max_rhs = 0.0f;
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            const int k = grid.getIndex(x, y);
+            grid.solution[k] = grid.open[k] * solution[y * rowStride + x];
+            grid.rhs[k] = grid.open[k] * rhs[y * rowStride + x];
+            max_rhs = std::max(max_rhs, std::abs(grid.rhs[k]));
+        }
+    }
+    const float max_residual = computeResidual(grid.solution.data(), grid.rhs.data(), grid.residual.data());
+    return max_rhs > 0.0f ? max_residual / max_rhs : max_residual;
+}
@@ -0,0 +1,38 @@
+#include "Simd.h"
+
+#if defined(SIMD_X86) && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+const char* getSimdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar: return "Scalar";
+    case SimdLevel::Avx2: return "AVX2";
+    case SimdLevel::Neon: return "NEON";
+    }
+    return "Unknown";
+}
+
+SimdLevel detectSimdLevel() {
+#if defined(SIMD_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return SimdLevel::Scalar;
+    // AVX needs OS support for saving the ymm registers
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return SimdLevel::Scalar;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) ? SimdLevel::Avx2 : SimdLevel::Scalar;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? SimdLevel::Avx2 : SimdLevel::Scalar;
+#endif
+#elif defined(SIMD_NEON)
+    return SimdLevel::Neon;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
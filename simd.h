@@ -0,0 +1,31 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Instruction sets the SIMD kernels (narrowphase, body forces, fluid sampling) can run on.
+// Each kernel runs whole vectors and returns the index it stopped at; the scalar code finishes
+// the leftover entries that don't fill a vector.
+enum class SimdLevel {
+    Scalar, // Plain C++, always available, reference for the others
+    Avx2,   // 8 floats per vector
+    Neon    // 4 floats per vector
+};
+
+const char* getSimdLevelName(SimdLevel level);
+// Best level supported by this CPU (and this build)
+SimdLevel detectSimdLevel();
+
+// Which kernels this build has. Kernel files include <immintrin.h> or <arm_neon.h> under these
+// and mark AVX2 functions with SIMD_AVX2_TARGET, so the rest of the build needs no AVX2 flag.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_AVX2_TARGET
+#else
+#define SIMD_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+// vdivq_f32 and vsqrtq_f32 are AArch64 only, 32-bit ARM uses the scalar kernels
+#define SIMD_NEON
+#endif
+
+#endif
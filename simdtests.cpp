@@ -0,0 +1,173 @@
+#include "SimdTests.h"
+#include "BodyForces.h"
+#include "BubbleStore.h"
+#include "FluidGrid2D.h"
+#include "Narrowphase.h"
+#include "ThreadPool.h"
+#include <glm/gtx/norm.hpp>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Every kernel runs on counts that leave each possible tail for the 4 and 8 wide kernels, on
+// inputs that mix lanes taking different branches.
+
+static int failed_checks = 0;
+
+static void check(const char* kernel, size_t count, float difference, float tolerance) {
+    if (difference <= tolerance) return;
+    printf("FAIL %s, %zu entries: difference %g over %g\n", kernel, count, difference, tolerance);
+    failed_checks++;
+}
+
+// Relative to the reference value, absolute below 1
+static float maxDifference(const std::vector<float>& reference, const std::vector<float>& values) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < reference.size(); ++i) {
+        float scale = glm::max(1.0f, glm::abs(reference[i]));
+        difference = glm::max(difference, glm::abs(values[i] - reference[i]) / scale);
+    }
+    return difference;
+}
+
+static float maxDifference(const std::vector<glm::vec2>& reference, const std::vector<glm::vec2>& values) {
+    float difference = 0.0f;
+    for (size_t i = 0; i < reference.size(); ++i) {
+        float scale = glm::max(1.0f, glm::length(reference[i]));
+        difference = glm::max(difference, glm::length(values[i] - reference[i]) / scale);
+    }
+    return difference;
+}
+
+static const size_t TEST_COUNTS[] = { 1, 2, 3, 4, 5, 7, 8, 9, 11, 15, 16, 17, 31, 33, 1001 };
+
+// Pairs i of a chain of bubbles, each pair a lane: overlapping, apart, or on top of each other
+// (degenerate, no normal) in an irregular pattern so one vector holds several kinds.
+static BubbleStore makePairChain(size_t pairCount, std::mt19937& engine) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    BubbleStore bubbles;
+    glm::vec2 position(100.0f, 100.0f);
+    for (size_t i = 0; i <= pairCount; ++i) {
+        const float radius = BUBBLE_MIN_RADIUS + unit(engine) * 10.0f;
+        bubbles.push_back(Bubble(static_cast<int>(i), position, radius, glm::vec2(unit(engine) - 0.5f, unit(engine) - 0.5f) * 40.0f));
+        const int kind = static_cast<int>(unit(engine) * 3.0f);
+        const float angle = unit(engine) * 6.2831853f;
+        const float distance = kind == 0 ? radius * 1.2f : kind == 1 ? radius * 4.0f : 0.001f;
+        position += glm::vec2(glm::cos(angle), glm::sin(angle)) * distance;
+    }
+    return bubbles;
+}
+
+static void testNarrowphase(SimdLevel level, ThreadPool& pool) {
+    std::mt19937 engine(1u);
+    for (size_t count : TEST_COUNTS) {
+        BubbleStore bubbles = makePairChain(count, engine);
+        std::vector<BubblePair> pairs;
+        for (size_t i = 0; i < count; ++i) {
+            pairs.push_back({ static_cast<int>(i), static_cast<int>(i + 1) });
+        }
+
+        Narrowphase scalar;
+        scalar.setSimdLevel(SimdLevel::Scalar);
+        Narrowphase simd;
+        simd.setSimdLevel(level);
+        PairDeltas reference;
+        PairDeltas results[2];
+        scalar.computeDeltas(bubbles, pairs, reference);
+        simd.computeDeltas(bubbles, pairs, results[0]);
+        simd.computeDeltas(bubbles, pairs, results[1], &pool);
+
+        for (const PairDeltas& result : results) {
+            float difference = 0.0f;
+            difference = glm::max(difference, maxDifference(reference.normal_x, result.normal_x));
+            difference = glm::max(difference, maxDifference(reference.normal_y, result.normal_y));
+            difference = glm::max(difference, maxDifference(reference.penetration, result.penetration));
+            difference = glm::max(difference, maxDifference(reference.force_x, result.force_x));
+            difference = glm::max(difference, maxDifference(reference.force_y, result.force_y));
+            difference = glm::max(difference, maxDifference(reference.correction_ax, result.correction_ax));
+            difference = glm::max(difference, maxDifference(reference.correction_ay, result.correction_ay));
+            difference = glm::max(difference, maxDifference(reference.correction_bx, result.correction_bx));
+            difference = glm::max(difference, maxDifference(reference.correction_by, result.correction_by));
+            check(&result == &results[0] ? "Narrowphase" : "Narrowphase on the pool", count, difference, 1.0e-5f);
+        }
+    }
+}
+
+// Inactive bubbles must keep their force, resting ones (no relative velocity) and tiny ones skip the drag
+static void testBodyForces(SimdLevel level) {
+    std::mt19937 engine(2u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t count : TEST_COUNTS) {
+        BubbleStore bubbles;
+        std::vector<glm::vec2> fluid_velocities(count);
+        std::vector<uint8_t> active(count);
+        for (size_t i = 0; i < count; ++i) {
+            const float radius = i % 5 == 3 ? 0.005f : BUBBLE_MIN_RADIUS + unit(engine) * 30.0f;
+            const glm::vec2 velocity = glm::vec2(unit(engine) - 0.5f, unit(engine) - 0.5f) * 80.0f;
+            bubbles.push_back(Bubble(static_cast<int>(i), glm::vec2(unit(engine), unit(engine)) * 1000.0f, radius, velocity));
+            fluid_velocities[i] = i % 3 == 1 ? velocity : glm::vec2(unit(engine) - 0.5f, unit(engine) - 0.5f) * 40.0f;
+            active[i] = unit(engine) < 0.7f;
+        }
+
+        std::vector<glm::vec2> results[2];
+        for (int k = 0; k < 2; ++k) {
+            // Marks every force, so one an inactive lane overwrote shows up as a difference
+            std::fill(bubbles.getForces(), bubbles.getForces() + count, glm::vec2(12345.0f, -6789.0f));
+            BodyForces body_forces;
+            body_forces.setSimdLevel(k == 0 ? SimdLevel::Scalar : level);
+            body_forces.compute(bubbles, fluid_velocities.data(), active.data());
+            results[k].assign(bubbles.getForces(), bubbles.getForces() + count);
+        }
+        check("Body forces", count, maxDifference(results[0], results[1]), 1.0e-5f);
+    }
+}
+
+// Points inside the grid, on its edges and outside it, for both sampling modes
+static void testFluidSampling(SimdLevel level) {
+    const float width = 640.0f;
+    const float height = 480.0f;
+    FluidGrid2D grid(static_cast<int>(width), static_cast<int>(height));
+    std::mt19937 engine(3u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < 400; ++i) {
+        Bubble stirrer(i, glm::vec2(unit(engine) * width, unit(engine) * height), BUBBLE_MIN_RADIUS,
+            glm::vec2(unit(engine) - 0.5f, unit(engine)) * 100.0f);
+        BubbleStore store;
+        store.push_back(stirrer);
+        grid.applyBubbleForce(store[0], 1.0f / 60.0f);
+    }
+    grid.update(1.0f / 60.0f);
+
+    std::uniform_real_distribution<float> spread(-0.1f, 1.1f);
+    const FluidSampling modes[] = { FluidSampling::Nearest, FluidSampling::Bilinear };
+    for (FluidSampling mode : modes) {
+        grid.setSampling(mode);
+        for (size_t count : TEST_COUNTS) {
+            std::vector<glm::vec2> positions(count);
+            for (size_t i = 0; i < count; ++i) {
+                positions[i] = i % 4 == 2 ? glm::vec2(width, unit(engine) * height) : glm::vec2(spread(engine) * width, spread(engine) * height);
+            }
+            std::vector<glm::vec2> results[2];
+            for (int k = 0; k < 2; ++k) {
+                results[k].resize(count);
+                grid.setSimdLevel(k == 0 ? SimdLevel::Scalar : level);
+                grid.getVelocitiesAt(positions.data(), count, results[k].data());
+            }
+            check(mode == FluidSampling::Nearest ? "Fluid sampling, nearest" : "Fluid sampling, bilinear", count,
+                maxDifference(results[0], results[1]), 1.0e-5f);
+        }
+    }
+}
+
+int runSimdTests() {
+    failed_checks = 0;
+    const SimdLevel level = detectSimdLevel();
+    printf("SIMD kernels against scalar, %s\n", getSimdLevelName(level));
+    ThreadPool pool(4);
+    testNarrowphase(level, pool);
+    testBodyForces(level);
+    testFluidSampling(level);
+    if (failed_checks == 0) printf("All kernels match\n");
+    else printf("%d checks failed\n", failed_checks);
+    return failed_checks;
+}
@@ -0,0 +1,9 @@
+#ifndef SIMD_TESTS_H
+#define SIMD_TESTS_H
+
+// SIMD kernels (narrowphase, body forces, fluid sampling) against their scalar references.
+// Returns the number of failed checks. Where the CPU has no SIMD level both sides run the scalar
+// kernel and the checks pass trivially, the level in use is printed.
+int runSimdTests();
+
+#endif
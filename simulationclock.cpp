@@ -0,0 +1,37 @@
+#include "SimulationClock.h"
+#include <algorithm>
+
+SimulationClock::SimulationClock(float fixedStep, int maxSubsteps)
+    : fixed_step(fixedStep > 0.0f ? fixedStep : 1.0f / 60.0f),
+    max_substeps(std::max(1, maxSubsteps)),
+    accumulator(0.0f),
+    last_substeps(0),
+    dropped_time(0.0) {
+}
+
+int SimulationClock::advance(float frameTime) {
+    accumulator += std::max(0.0f, frameTime);
+    int steps = static_cast<int>(accumulator / fixed_step);
+    if (steps > max_substeps) {
+        // Keep the fraction of a step so interpolation stays smooth, drop the rest
+        float kept = accumulator - steps * fixed_step;
+        dropped_time += accumulator - kept - max_substeps * fixed_step;
+        steps = max_substeps;
+        accumulator = kept;
+    }
+    else {
+        accumulator -= steps * fixed_step;
+    }
+    last_substeps = steps;
+    return steps;
+}
+
+void SimulationClock::setFixedStep(float fixedStep) {
+    if (fixedStep <= 0.0f) return;
+    // The pending time stays, the next advance turns it into steps of the new size
+    fixed_step = fixedStep;
+}
+
+void SimulationClock::setMaxSubsteps(int maxSubsteps) {
+    max_substeps = std::max(1, maxSubsteps);
+}
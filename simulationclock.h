@@ -0,0 +1,36 @@
+#ifndef SIMULATION_CLOCK_H
+#define SIMULATION_CLOCK_H
+
+// Fixed-timestep accumulator. Frame time goes in, whole fixed steps come out, and the
+// remainder carries over to the next frame, so the simulation always steps by the same dt
+// however the frame rate varies. Rendering blends the last two states by getAlpha().
+// The step may be changed between frames (BubbleSimulator::computeStableStep), pending time is kept.
+class SimulationClock {
+public:
+    SimulationClock(float fixedStep, int maxSubsteps);
+
+    // Adds frameTime and returns the number of fixed steps to run now, at most maxSubsteps.
+    // Time beyond that is dropped so a long hitch slows the simulation down instead of
+    // making every following frame run more steps than it can afford (spiral of death).
+    int advance(float frameTime);
+
+    // How far the accumulated time is into the next step, in [0, 1) after advance
+    float getAlpha() const { return accumulator / fixed_step; }
+
+    void setFixedStep(float fixedStep);
+    float getFixedStep() const { return fixed_step; }
+    void setMaxSubsteps(int maxSubsteps);
+    int getMaxSubsteps() const { return max_substeps; }
+
+    int getLastSubsteps() const { return last_substeps; }
+    double getDroppedTime() const { return dropped_time; } // Total seconds lost to the substep cap
+
+private:
+    float fixed_step;
+    int max_substeps;
+    float accumulator;
+    int last_substeps;
+    double dropped_time;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SIMULATION_CONFIG_H
+#define SIMULATION_CONFIG_H
+
+// Optional parts of a simulation step, chosen at run time. Each is a branch in the loops it
+// touches; compiling them out into separate steps measured no faster.
+struct SimulationFeatures {
+    bool fusion;           // Overlapping pairs may fuse (with the fusion probability)
+    bool adhesion;         // Static and dynamic adhesion on surfaces, friction of the XPBD surface contacts
+    bool two_way_coupling; // Bubbles push the fluid
+    bool lift;             // Lift from the fluid vorticity
+};
+
+const SimulationFeatures DEFAULT_SIMULATION_FEATURES = { true, true, true, false };
+
+#endif
@@ -12,20 +12,60 @@ const float GAS_DENSITY = 0.1f;         // Simplified density of gas in bubbles
 const float BUBBLE_MIN_RADIUS = 8.0f;
 const float BUBBLE_MAX_RADIUS = 40.0f;
 const float BUBBLE_GROWTH_RATE = 1.5f; // Radius increment per second (dr/dt = const)
+const int BUBBLE_POOL_CAPACITY = 4096; // Most bubbles alive at once, the pool is allocated once at this size
 
 // --- Collision ---
 const float BUBBLE_COLLISION_STIFFNESS = 900.0f; // Increase for stronger repulsion
 const float BUBBLE_COLLISION_DAMPING = 15.0f;   // Adjusted damping
 const float BUBBLE_FUSION_PROBABILITY = 0.01; // Lowered to see more repulsions, or set to 0.0 to test repulsion only, or 1.0 to test fusion only.
+const float CONTACT_HYSTERESIS = 1.0f; // Gap (pixels) a touching pair may open before its contact ends, must stay below 2 * BROADPHASE_MARGIN
+const float BROADPHASE_MARGIN = 2.0f; // Pixels added to bubble bounds so position corrections within a step don't lose contacts
+const float BROADPHASE_CELL_SIZE = 2.0f * BUBBLE_MAX_RADIUS + 2.0f * BROADPHASE_MARGIN; // Largest contact distance (hysteresis included), so contacts are always in neighbouring cells
+const float AABB_TREE_FAT_MARGIN = 6.0f; // Extra room in AABB tree leaves before a moving or growing bubble is reinserted
+const int IMPLICIT_CG_ITERATIONS = 8;      // Most conjugate gradient iterations per step of the implicit integrator
+const float IMPLICIT_CG_TOLERANCE = 1.0e-3f; // Stop once the residual is this fraction of the right hand side
+const int XPBD_ITERATIONS = 8;               // Constraint projections per step of the XPBD solver, its cost does not depend on dt
+const float XPBD_CONTACT_COMPLIANCE = 1.0e-4f; // Inverse stiffness of XPBD bubble-bubble contacts, 0 is rigid
+const float VERLET_SKIN = 8.0f; // Extra reach of Verlet neighbour lists, lists are rebuilt once a bubble has used up half of it
 
 // --- Surface Interaction & Adhesion (Coefficients from paper, needs tuning) ---
 const float STATIC_ADHESION_COEFFICIENT = 0.5f;
 const float DYNAMIC_ADHESION_COEFFICIENT = 0.2f;
 
+// --- Sleeping ---
+const float SLEEP_VELOCITY_THRESHOLD = 0.5f;     // Speed (pixels/s) below which a bubble on a surface counts as still
+const float SLEEP_ACCELERATION_THRESHOLD = 1.0f; // Net tangential force per unit mass (pixels/s^2) below which it counts as still
+const int SLEEP_STEPS = 30;                      // Steps a whole contact island must stay still before it sleeps
+const float SLEEP_WAKE_FLUID_SPEED = 20.0f;      // Fluid speed (pixels/s) in its cell that wakes a sleeping bubble
+
+// --- Multi-rate ---
+const int MULTIRATE_INTERVAL = 4;             // Steps between updates of a slow-lane bubble
+const float MULTIRATE_SPEED_THRESHOLD = 2.0f; // Speed (pixels/s) along or away from its surface below which a bubble moves to the slow lane
+
 // --- Fluid Interaction ---
 const float FLUID_DRAG_COEFFICIENT = 0.1f;
+const int FLUID_PRESSURE_ITERATIONS = 40;       // Most iterations of the StableFluids pressure solve per step, sweeps or V-cycles
+const float FLUID_PRESSURE_TOLERANCE = 1.0e-3f; // The pressure solve stops once the largest residual is this fraction of the largest divergence
+const float FLUID_STEP_BUDGET_MS = 0.0f;        // The pressure solve stops once the fluid update has taken this long, 0 for no limit (machine independent results)
+const float FLUID_LIFT_COEFFICIENT = 0.5f; // Lift per unit mass, relative speed and vorticity, only with the lift feature
+
+// --- Time Stepping ---
+const float SIMULATION_STEP = 1.0f / 240.0f; // Fixed simulation dt (seconds), independent of the frame rate, when not adaptive
+const int SIMULATION_MAX_SUBSTEPS = 16;      // Most fixed steps per frame, slower frames lose the extra time
+const float ADAPTIVE_STEP_CFL = 0.5f;        // Fraction of the smallest radius a bubble, or of a grid cell the fluid, may cross in one step
+const float ADAPTIVE_STEP_MIN = 1.0f / 960.0f; // Smallest adaptive dt, SIMULATION_MAX_SUBSTEPS of these still cover a 60 Hz frame
+const float ADAPTIVE_STEP_MAX = 1.0f / 30.0f;  // Largest adaptive dt, taken when the scene is calm
+
+// --- Pressure Solve ---
+const int POISSON_SMOOTHING_SWEEPS = 2;  // Red-black Gauss-Seidel sweeps before and after each coarse correction
+const int POISSON_COARSEST_SWEEPS = 32;  // Sweeps (half forward, half backward) that solve the coarsest multigrid level
+const int POISSON_COARSEST_SIZE = 4;     // Multigrid levels group 3x3 blocks until neither side has more blocks than this
+const float POISSON_STRONG_COUPLING = 0.08f; // Couplings weaker than this times sqrt(a_ii * a_jj) don't join two unknowns into one coarse unknown
 
 // --- Simulation Grid ---
 const int GRID_CELL_SIZE = 20; // Pixels
+const float SURFACE_GRID_CELL_SIZE = 40.0f; // Pixels, cell size of the surface segment binning
+const float SURFACE_FIELD_CELL_SIZE = 4.0f; // Pixels between nodes of the baked surface distance field
+const float SURFACE_FIELD_BAND = BUBBLE_MAX_RADIUS + 2.0f * SURFACE_FIELD_CELL_SIZE; // Distance stored exactly around surfaces
 
 #endif 
@@ -0,0 +1,102 @@
+#include "SimulationTests.h"
+#include "BubbleSimulator.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static int failed_checks = 0;
+
+static void check(const char* test, bool passed) {
+    if (passed) return;
+    printf("FAIL %s\n", test);
+    failed_checks++;
+}
+
+template <typename T>
+static void appendBytes(std::vector<unsigned char>& bytes, const T& value) {
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(&value);
+    bytes.insert(bytes.end(), begin, begin + sizeof(T));
+}
+
+// Every field of every bubble, in store order
+static std::vector<unsigned char> storeBytes(const BubbleStore& bubbles) {
+    std::vector<unsigned char> bytes;
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        ConstBubbleRef bubble = bubbles[i];
+        appendBytes(bytes, bubble.id);
+        appendBytes(bytes, bubble.position);
+        appendBytes(bytes, bubble.velocity);
+        appendBytes(bytes, bubble.radius);
+        appendBytes(bytes, bubble.mass);
+        appendBytes(bytes, bubble.force_accumulator);
+        appendBytes(bytes, bubble.on_surface);
+        appendBytes(bytes, bubble.surface_id);
+        appendBytes(bytes, bubble.time_on_surface);
+        appendBytes(bytes, bubble.surface_normal);
+        appendBytes(bytes, bubble.sleeping);
+        appendBytes(bytes, bubble.quiet_steps);
+        appendBytes(bytes, bubble.sleep_contacts);
+        appendBytes(bytes, bubble.slow_lane);
+        appendBytes(bytes, bubble.lane_time);
+        appendBytes(bytes, bubble.marked_for_removal);
+        appendBytes(bytes, bubbles.getPreviousPositions()[i]);
+    }
+    return bytes;
+}
+
+// A crowded tank under two shelves, so pairs overlap, fuse, rest on the shelves and fall asleep
+static BubbleStore runBatchedScene(int threadCount, size_t& startCount) {
+    const float width = 800.0f;
+    const float height = 600.0f;
+    BubbleSimulator simulator(static_cast<int>(width), static_cast<int>(height));
+    simulator.setSeed(99u);
+    simulator.setNarrowphaseMode(NarrowphaseMode::Batched);
+    simulator.setThreadCount(threadCount);
+    simulator.setFusionProbability(0.002f);
+    simulator.addSurface(Surface2D(0, glm::vec2(50.0f, 300.0f), glm::vec2(400.0f, 330.0f)));
+    simulator.addSurface(Surface2D(1, glm::vec2(420.0f, 360.0f), glm::vec2(750.0f, 320.0f)));
+
+    std::mt19937 engine(5u);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    BubbleStore bubbles;
+    for (int i = 0; i < 800; ++i) {
+        glm::vec2 position(60.0f + unit(engine) * (width - 120.0f), 20.0f + unit(engine) * 260.0f);
+        bubbles.push_back(Bubble(i, position, BUBBLE_MIN_RADIUS + unit(engine) * 6.0f));
+    }
+    startCount = bubbles.size();
+
+    for (int step = 0; step < 120; ++step) {
+        simulator.update(SIMULATION_STEP, bubbles);
+    }
+    return bubbles;
+}
+
+// Batched steps give the same bubbles, bit for bit, for any thread count: the narrowphase, the
+// per-bubble sums and the fusion stage all run in an order that doesn't depend on the threads.
+static void testBatchedDeterminism() {
+    size_t start_count = 0;
+    const BubbleStore single_thread = runBatchedScene(1, start_count);
+    // Without a fusion the fusion stage went untested
+    check("Batched steps, the scene fused no bubbles", single_thread.size() < start_count);
+
+    const std::vector<unsigned char> reference = storeBytes(single_thread);
+    const int thread_counts[] = { 2, 4 };
+    for (int threads : thread_counts) {
+        size_t count = 0;
+        const std::vector<unsigned char> bytes = storeBytes(runBatchedScene(threads, count));
+        if (bytes.size() != reference.size() || memcmp(bytes.data(), reference.data(), bytes.size()) != 0) {
+            printf("FAIL Batched steps, %d threads differ from 1 thread\n", threads);
+            failed_checks++;
+        }
+    }
+}
+
+int runSimulationTests() {
+    failed_checks = 0;
+    printf("Simulation steps\n");
+    testBatchedDeterminism();
+    if (failed_checks == 0) printf("All simulation checks pass\n");
+    else printf("%d checks failed\n", failed_checks);
+    return failed_checks;
+}
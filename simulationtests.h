@@ -0,0 +1,8 @@
+#ifndef SIMULATION_TESTS_H
+#define SIMULATION_TESTS_H
+
+// Whole simulation steps: Batched steps with 1, 2 and 4 threads give bit-identical bubbles.
+// Returns the number of failed checks.
+int runSimulationTests();
+
+#endif
@@ -0,0 +1,88 @@
+#include "SortAndSweep.h"
+#include <algorithm>
+
+void SortAndSweep::syncIntervals(const BubbleStore& bubbles) {
+    step_stamp++;
+
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        ConstBubbleRef bubble = bubbles[i];
+        if (bubble.marked_for_removal) continue;
+
+        const BubbleHandle handle = bubbles.getHandle(i);
+        if (handle.slot >= interval_of_handle.size()) interval_of_handle.resize(handle.slot + 1, -1);
+
+        // A reused store slot holds a different bubble, its old interval is dropped below
+        int slot = interval_of_handle[handle.slot];
+        if (slot < 0 || intervals[slot].handle != handle) {
+            // New bubble, goes to the end of the order and gets sorted into place
+            if (!free_slots.empty()) {
+                slot = free_slots.back();
+                free_slots.pop_back();
+            }
+            else {
+                slot = static_cast<int>(intervals.size());
+                intervals.push_back(Interval());
+            }
+            interval_of_handle[handle.slot] = slot;
+            order.push_back(slot);
+        }
+
+        const float extent = bubble.radius + BROADPHASE_MARGIN;
+        Interval& interval = intervals[slot];
+        interval.handle = handle;
+        interval.bubble = static_cast<int>(i);
+        interval.min_x = bubble.position.x - extent;
+        interval.max_x = bubble.position.x + extent;
+        interval.min_y = bubble.position.y - extent;
+        interval.max_y = bubble.position.y + extent;
+        interval.last_seen = step_stamp;
+    }
+
+    // Drop intervals of bubbles that are gone, keeping the rest of the order intact
+    size_t kept = 0;
+    for (size_t k = 0; k < order.size(); ++k) {
+        Interval& interval = intervals[order[k]];
+        if (interval.last_seen != step_stamp) {
+            if (interval_of_handle[interval.handle.slot] == order[k]) interval_of_handle[interval.handle.slot] = -1;
+            free_slots.push_back(order[k]);
+            continue;
+        }
+        order[kept++] = order[k];
+    }
+    order.resize(kept);
+}
+
+void SortAndSweep::insertionSort() {
+    last_swap_count = 0;
+    for (size_t k = 1; k < order.size(); ++k) {
+        const int slot = order[k];
+        const float key = intervals[slot].min_x;
+        size_t m = k;
+        while (m > 0 && intervals[order[m - 1]].min_x > key) {
+            order[m] = order[m - 1];
+            --m;
+        }
+        order[m] = slot;
+        last_swap_count += k - m;
+    }
+}
+
+void SortAndSweep::findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) {
+    syncIntervals(bubbles);
+    insertionSort();
+
+    // Sweep: only intervals starting before the current one ends can overlap it in x
+    pairs.clear();
+    for (size_t k = 0; k < order.size(); ++k) {
+        const Interval& current = intervals[order[k]];
+        for (size_t m = k + 1; m < order.size(); ++m) {
+            const Interval& other = intervals[order[m]];
+            if (other.min_x >= current.max_x) break;
+            if (other.min_y >= current.max_y || other.max_y <= current.min_y) continue;
+
+            pairs.push_back({ std::min(current.bubble, other.bubble), std::max(current.bubble, other.bubble) });
+        }
+    }
+
+    sortPairs(pairs, static_cast<int>(bubbles.size()));
+}
@@ -0,0 +1,41 @@
+#ifndef SORT_AND_SWEEP_H
+#define SORT_AND_SWEEP_H
+
+#include <vector>
+#include "BubbleStore.h"
+#include "Broadphase.h"
+
+// Incremental sort-and-sweep broadphase along the x axis.
+// Bubbles keep their slot in a persistent list sorted by the left edge of their bounds.
+// Bubbles rise slowly and barely reorder in x between steps, so the insertion sort that
+// restores the order each step is close to linear.
+class SortAndSweep : public Broadphase {
+public:
+    void findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) override;
+
+    // Number of order swaps done by the last update (how much the x order changed)
+    size_t getLastSwapCount() const { return last_swap_count; }
+
+private:
+    struct Interval {
+        BubbleHandle handle; // Bubble this interval tracks
+        int bubble;      // Index into the bubble list for the current step
+        float min_x, max_x;
+        float min_y, max_y;
+        int last_seen;   // Step stamp, stale intervals get dropped
+    };
+
+    std::vector<Interval> intervals;           // Storage, slots are reused through free_slots
+    std::vector<int> free_slots;
+    std::vector<int> order;                    // Interval slots sorted by min_x
+    std::vector<int> interval_of_handle;       // BubbleHandle::slot -> interval slot, -1 if none
+
+    int step_stamp = 0;
+    size_t last_swap_count = 0;
+
+    // Refreshes bounds, adds new bubbles and drops removed ones
+    void syncIntervals(const BubbleStore& bubbles);
+    void insertionSort();
+};
+
+#endif
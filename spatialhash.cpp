@@ -0,0 +1,75 @@
+#include "SpatialHash.h"
+#include <algorithm>
+
+SpatialHash::SpatialHash(float worldWidth, float worldHeight, float cellSize)
+    : cell_size(cellSize) {
+    width_cells = std::max(1, static_cast<int>(worldWidth / cell_size) + 1);
+    height_cells = std::max(1, static_cast<int>(worldHeight / cell_size) + 1);
+    cell_start.resize(width_cells * height_cells + 1, 0);
+}
+
+glm::ivec2 SpatialHash::getCellCoord(glm::vec2 position) const {
+    int x_idx = static_cast<int>(glm::floor(position.x / cell_size));
+    int y_idx = static_cast<int>(glm::floor(position.y / cell_size));
+    return glm::ivec2(
+        std::max(0, std::min(x_idx, width_cells - 1)),
+        std::max(0, std::min(y_idx, height_cells - 1))
+    );
+}
+
+void SpatialHash::build(const BubbleStore& bubbles) {
+    const int cell_count = width_cells * height_cells;
+    std::fill(cell_start.begin(), cell_start.end(), 0);
+    bubble_cell.resize(bubbles.size());
+
+    // Count bubbles per cell
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        if (bubbles[i].marked_for_removal) {
+            bubble_cell[i] = -1;
+            continue;
+        }
+        glm::ivec2 cell = getCellCoord(bubbles[i].position);
+        bubble_cell[i] = cell.y * width_cells + cell.x;
+        cell_start[bubble_cell[i] + 1]++;
+    }
+
+    // Prefix sum into offsets
+    for (int c = 0; c < cell_count; ++c) {
+        cell_start[c + 1] += cell_start[c];
+    }
+
+    // Scatter, walking bubbles in order keeps every cell sorted by index
+    cell_entries.resize(cell_start[cell_count]);
+    cell_cursor.assign(cell_start.begin(), cell_start.end() - 1);
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        if (bubble_cell[i] < 0) continue;
+        cell_entries[cell_cursor[bubble_cell[i]]++] = static_cast<int>(i);
+    }
+}
+
+void SpatialHash::findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) {
+    build(bubbles);
+    pairs.clear();
+    const int bubble_count = static_cast<int>(bubbles.size());
+
+    for (int i = 0; i < bubble_count; ++i) {
+        if (bubble_cell[i] < 0) continue;
+        const int cx = bubble_cell[i] % width_cells;
+        const int cy = bubble_cell[i] / width_cells;
+
+        // Every higher index in the 3x3 neighbourhood is a candidate
+        for (int y = std::max(0, cy - 1); y <= std::min(cy + 1, height_cells - 1); ++y) {
+            for (int x = std::max(0, cx - 1); x <= std::min(cx + 1, width_cells - 1); ++x) {
+                const int cell = y * width_cells + x;
+                const int* first = cell_entries.data() + cell_start[cell];
+                const int* last = cell_entries.data() + cell_start[cell + 1];
+                for (const int* e = std::upper_bound(first, last, i); e != last; ++e) {
+                    pairs.push_back({ i, *e });
+                }
+            }
+        }
+    }
+
+    // Keep the brute-force visiting order so contact resolution stays identical
+    sortPairs(pairs, bubble_count);
+}
@@ -0,0 +1,36 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BubbleStore.h"
+#include "Broadphase.h"
+
+// Uniform grid broadphase for bubble-bubble collisions.
+// Cells are at least as wide as the largest possible contact distance (two max radii),
+// so two overlapping bubbles always share a cell or sit in neighbouring cells.
+class SpatialHash : public Broadphase {
+public:
+    SpatialHash(float worldWidth, float worldHeight, float cellSize);
+
+    // Bins every live bubble into its cell (counting sort, rebuilt every step)
+    void build(const BubbleStore& bubbles);
+
+    // Rebuilds the grid and writes every pair from neighbouring cells
+    void findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) override;
+
+private:
+    float cell_size;
+    int width_cells;
+    int height_cells;
+
+    std::vector<int> cell_start;   // Offset of each cell into cell_entries (size = cells + 1)
+    std::vector<int> cell_entries; // Bubble indices grouped by cell, ascending within a cell
+    std::vector<int> bubble_cell;  // Cell of each bubble, -1 if the bubble is skipped
+    std::vector<int> cell_cursor;  // Scatter cursor used by build
+
+    // Positions outside the world are clamped to the border cells
+    glm::ivec2 getCellCoord(glm::vec2 position) const;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define SURFACE2D_H
 
 #include <glm/glm.hpp>
+#include "SimulationConstants.h"
 
 // Represents a 2D surface
 struct Surface2D {
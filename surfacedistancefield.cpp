@@ -0,0 +1,109 @@
+#include "SurfaceDistanceField.h"
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+
+SurfaceDistanceField::SurfaceDistanceField(float worldWidth, float worldHeight, float cellSize, float band)
+    : cell_size(cellSize), band(band) {
+    width_nodes = std::max(2, static_cast<int>(glm::ceil(worldWidth / cell_size)) + 1);
+    height_nodes = std::max(2, static_cast<int>(glm::ceil(worldHeight / cell_size)) + 1);
+    distances.resize(width_nodes * height_nodes, band);
+    normals.resize(width_nodes * height_nodes, glm::vec2(0.0f, 1.0f));
+    nearest_surface.resize(width_nodes * height_nodes, -1);
+}
+
+SurfaceSample SurfaceDistanceField::evaluateSegment(int surfaceIndex, glm::vec2 position) const {
+    const Segment& segment = segments[surfaceIndex];
+    glm::vec2 line_vec = segment.end - segment.start;
+    float length_sq = glm::dot(line_vec, line_vec);
+
+    // Same closest point projection as the segment collision test
+    float t = length_sq > 0.0f ? glm::clamp(glm::dot(position - segment.start, line_vec) / length_sq, 0.0f, 1.0f) : 0.0f;
+    glm::vec2 vec_to_closest = position - (segment.start + t * line_vec);
+    float dist = glm::length(vec_to_closest);
+    float side = glm::dot(vec_to_closest, segment.normal) < 0.0f ? -1.0f : 1.0f;
+
+    SurfaceSample result;
+    result.distance = side * dist;
+    result.normal = dist > 0.0001f ? vec_to_closest * (side / dist) : segment.normal;
+    result.surface_index = surfaceIndex;
+    return result;
+}
+
+void SurfaceDistanceField::addSurface(const Surface2D& surface, int surfaceIndex) {
+    if (static_cast<int>(segments.size()) <= surfaceIndex) segments.resize(surfaceIndex + 1);
+    segments[surfaceIndex] = { surface.start_point, surface.end_point, surface.normal };
+
+    // Only nodes within the band of the new segment can change
+    glm::vec2 bounds_min = glm::min(surface.start_point, surface.end_point) - glm::vec2(band);
+    glm::vec2 bounds_max = glm::max(surface.start_point, surface.end_point) + glm::vec2(band);
+    int x_first = std::max(0, static_cast<int>(glm::floor(bounds_min.x / cell_size)));
+    int y_first = std::max(0, static_cast<int>(glm::floor(bounds_min.y / cell_size)));
+    int x_last = std::min(width_nodes - 1, static_cast<int>(glm::ceil(bounds_max.x / cell_size)));
+    int y_last = std::min(height_nodes - 1, static_cast<int>(glm::ceil(bounds_max.y / cell_size)));
+
+    for (int y = y_first; y <= y_last; ++y) {
+        for (int x = x_first; x <= x_last; ++x) {
+            SurfaceSample node = evaluateSegment(surfaceIndex, glm::vec2(x * cell_size, y * cell_size));
+            float dist = glm::abs(node.distance);
+
+            const int index = y * width_nodes + x;
+            // Strictly closer only, so earlier surfaces win ties like in the segment test
+            if (dist >= band || (nearest_surface[index] >= 0 && dist >= glm::abs(distances[index]))) continue;
+
+            distances[index] = node.distance;
+            normals[index] = node.normal;
+            nearest_surface[index] = surfaceIndex;
+        }
+    }
+}
+
+SurfaceSample SurfaceDistanceField::sample(glm::vec2 position) const {
+    glm::vec2 grid_pos = position / cell_size;
+    grid_pos = glm::clamp(grid_pos, glm::vec2(0.0f), glm::vec2(width_nodes - 1.001f, height_nodes - 1.001f));
+    int x0 = static_cast<int>(grid_pos.x);
+    int y0 = static_cast<int>(grid_pos.y);
+    float fx = grid_pos.x - x0;
+    float fy = grid_pos.y - y0;
+
+    const int corners[4] = { y0 * width_nodes + x0, y0 * width_nodes + x0 + 1, (y0 + 1) * width_nodes + x0, (y0 + 1) * width_nodes + x0 + 1 };
+    const float weights[4] = { (1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy };
+
+    // Seam: the corners disagree on the surface or on the side (only matters near the surface)
+    const int surface = nearest_surface[corners[0]];
+    bool seam = false;
+    for (int c = 1; c < 4; ++c) {
+        const int other = nearest_surface[corners[c]];
+        if (other != surface ||
+            (other >= 0 && (distances[corners[c]] < 0.0f) != (distances[corners[0]] < 0.0f))) {
+            seam = true;
+        }
+    }
+
+    if (seam) {
+        // Exact distance to each distinct corner surface, first surface wins ties
+        SurfaceSample best = { band, glm::vec2(0.0f, 1.0f), -1 };
+        for (int c = 0; c < 4; ++c) {
+            const int index = nearest_surface[corners[c]];
+            if (index < 0) continue;
+            SurfaceSample candidate = evaluateSegment(index, position);
+            float dist = glm::abs(candidate.distance);
+            float best_dist = glm::abs(best.distance);
+            if (dist < best_dist || (dist == best_dist && best.surface_index >= 0 && index < best.surface_index)) {
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    SurfaceSample result;
+    result.distance = 0.0f;
+    glm::vec2 normal(0.0f);
+    for (int c = 0; c < 4; ++c) {
+        result.distance += distances[corners[c]] * weights[c];
+        normal += normals[corners[c]] * weights[c];
+    }
+    float normal_length_sq = glm::length2(normal);
+    result.normal = normal_length_sq > 0.000001f ? normal / glm::sqrt(normal_length_sq) : normals[corners[0]];
+    result.surface_index = surface;
+    return result;
+}
@@ -0,0 +1,51 @@
+#ifndef SURFACE_DISTANCE_FIELD_H
+#define SURFACE_DISTANCE_FIELD_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Surface2D.h"
+
+// Result of a distance field lookup.
+struct SurfaceSample {
+    float distance;    // Signed distance to the nearest surface, positive on its normal (fluid) side
+    glm::vec2 normal;  // Gradient of the distance, equal to the surface normal away from segment ends
+    int surface_index; // Index of the nearest surface in the simulator's list, -1 if none is within the band
+};
+
+// Signed distance field baked from the Surface2D segments on a regular grid of nodes.
+// Only a band around the segments is stored exactly; nodes further away hold +band and no surface.
+// Adding a surface only revisits the nodes inside its band, so rebakes are incremental.
+// Open segments make the sign jump along their extension past the end points, and crossings
+// make the nearest surface jump. Cells straddling such a seam are resolved exactly against the
+// (at most four) surfaces of their nodes instead of being interpolated.
+class SurfaceDistanceField {
+public:
+    SurfaceDistanceField(float worldWidth, float worldHeight, float cellSize, float band);
+
+    void addSurface(const Surface2D& surface, int surfaceIndex);
+
+    // Bilinear lookup of distance and normal (exact on seams), constant cost per query
+    SurfaceSample sample(glm::vec2 position) const;
+
+private:
+    struct Segment {
+        glm::vec2 start;
+        glm::vec2 end;
+        glm::vec2 normal;
+    };
+
+    // Exact signed distance and gradient to one segment
+    SurfaceSample evaluateSegment(int surfaceIndex, glm::vec2 position) const;
+
+    float cell_size;
+    float band;
+    int width_nodes;
+    int height_nodes;
+
+    std::vector<float> distances;
+    std::vector<glm::vec2> normals;
+    std::vector<int> nearest_surface;
+    std::vector<Segment> segments; // Indexed like the simulator's surface list
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "SurfaceGrid.h"
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+
+// Distance from a point to the segment [start, end]
+static float distanceToSegment(glm::vec2 point, glm::vec2 start, glm::vec2 end) {
+    glm::vec2 line_vec = end - start;
+    float length_sq = glm::dot(line_vec, line_vec);
+    float t = length_sq > 0.0f ? glm::clamp(glm::dot(point - start, line_vec) / length_sq, 0.0f, 1.0f) : 0.0f;
+    return glm::length(point - (start + t * line_vec));
+}
+
+SurfaceGrid::SurfaceGrid(float worldWidth, float worldHeight, float cellSize, float reach)
+    : cell_size(cellSize), reach(reach) {
+    width_cells = std::max(1, static_cast<int>(worldWidth / cell_size) + 1);
+    height_cells = std::max(1, static_cast<int>(worldHeight / cell_size) + 1);
+    cells.resize(width_cells * height_cells);
+}
+
+glm::ivec2 SurfaceGrid::getCellCoord(glm::vec2 position) const {
+    int x_idx = static_cast<int>(glm::floor(position.x / cell_size));
+    int y_idx = static_cast<int>(glm::floor(position.y / cell_size));
+    return glm::ivec2(
+        std::max(0, std::min(x_idx, width_cells - 1)),
+        std::max(0, std::min(y_idx, height_cells - 1))
+    );
+}
+
+void SurfaceGrid::addSurface(const Surface2D& surface, int surfaceIndex) {
+    // Cells overlapped by the segment's bounds grown by the reach
+    glm::vec2 bounds_min = glm::min(surface.start_point, surface.end_point) - glm::vec2(reach);
+    glm::vec2 bounds_max = glm::max(surface.start_point, surface.end_point) + glm::vec2(reach);
+    glm::ivec2 first = getCellCoord(bounds_min);
+    glm::ivec2 last = getCellCoord(bounds_max);
+
+    // A cell is kept if any point in it can be within reach of the segment
+    const float half_diagonal = 0.5f * cell_size * glm::sqrt(2.0f);
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            glm::vec2 cell_center((x + 0.5f) * cell_size, (y + 0.5f) * cell_size);
+            // Border cells also hold everything clamped into them, so never skip those
+            bool border = x == 0 || y == 0 || x == width_cells - 1 || y == height_cells - 1;
+            if (!border && distanceToSegment(cell_center, surface.start_point, surface.end_point) > reach + half_diagonal) {
+                continue;
+            }
+            cells[y * width_cells + x].push_back(surfaceIndex);
+        }
+    }
+}
+
+const std::vector<int>& SurfaceGrid::getCandidates(glm::vec2 position) const {
+    glm::ivec2 cell = getCellCoord(position);
+    return cells[cell.y * width_cells + cell.x];
+}
@@ -0,0 +1,33 @@
+#ifndef SURFACE_GRID_H
+#define SURFACE_GRID_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Surface2D.h"
+
+// Static grid binning of Surface2D segments for bubble-surface collision.
+// Each cell lists every segment that passes within `reach` of the cell, so a bubble whose
+// radius is at most `reach` only has to test the segments of the cell holding its center.
+// Segments are binned once, when they are added.
+class SurfaceGrid {
+public:
+    SurfaceGrid(float worldWidth, float worldHeight, float cellSize, float reach);
+
+    // Bins a segment, surfaceIndex is its index in the simulator's surface list
+    void addSurface(const Surface2D& surface, int surfaceIndex);
+
+    // Surface indices near a position, in ascending order (the order surfaces were added)
+    const std::vector<int>& getCandidates(glm::vec2 position) const;
+
+private:
+    float cell_size;
+    float reach;
+    int width_cells;
+    int height_cells;
+    std::vector<std::vector<int>> cells;
+
+    // Positions outside the world are clamped to the border cells
+    glm::ivec2 getCellCoord(glm::vec2 position) const;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "Benchmark.h"
+#include "BubbleStoreTests.h"
+#include "SimdTests.h"
+#include "SimulationTests.h"
+#include <cstring>
+
+// Test and benchmark runner, kept out of the application so the allocation counter's global
+// operator new replacement only lives here. Exits with the number of failed checks, or runs the
+// benchmarks with "--bench".
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        runBenchmarks();
+        return 0;
+    }
+    return runBubbleStoreTests() + runSimdTests() + runSimulationTests();
+}
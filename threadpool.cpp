@@ -0,0 +1,96 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+    : thread_count(std::max(1, threadCount)),
+    current_function(nullptr),
+    current_work(nullptr),
+    current_count(0),
+    active_ranges(0),
+    pending_workers(0),
+    generation(0),
+    stopping(false) {
+    for (int i = 1; i < thread_count; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::getRange(size_t count, int ranges, int range, size_t& begin, size_t& end) {
+    begin = count * range / ranges;
+    end = count * (range + 1) / ranges;
+}
+
+void ThreadPool::run(size_t count, size_t minPerThread, RangeFunction function, const void* work) {
+    if (count == 0) return;
+    size_t useful = minPerThread > 0 ? std::max<size_t>(1, count / minPerThread) : count;
+    int ranges = static_cast<int>(std::min<size_t>(thread_count, useful));
+    if (ranges == 1) {
+        function(work, 0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_function = function;
+        current_work = work;
+        current_count = count;
+        active_ranges = ranges;
+        pending_workers = thread_count - 1;
+        generation++;
+    }
+    work_ready.notify_all();
+
+    size_t begin, end;
+    getRange(count, ranges, 0, begin, end);
+    function(work, begin, end);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this] { return pending_workers == 0; });
+    current_function = nullptr;
+    current_work = nullptr;
+}
+
+void ThreadPool::workerLoop(int workerIndex) {
+    unsigned int seen_generation = 0;
+    for (;;) {
+        RangeFunction function;
+        const void* work;
+        size_t count;
+        int ranges;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) return;
+            seen_generation = generation;
+            function = current_function;
+            work = current_work;
+            count = current_count;
+            ranges = active_ranges;
+        }
+
+        // Workers past the number of ranges sit this loop out
+        if (workerIndex < ranges) {
+            size_t begin, end;
+            getRange(count, ranges, workerIndex, begin, end);
+            function(work, begin, end);
+        }
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            last = --pending_workers == 0;
+        }
+        if (last) work_done.notify_one();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Fixed set of worker threads for data-parallel loops.
+// parallelFor splits [0, count) into one contiguous range per thread, always the same ranges for
+// the same count and thread count, and the calling thread works on the first range.
+class ThreadPool {
+public:
+    // threadCount includes the calling thread, 1 runs everything inline
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls work(begin, end) over [0, count) and returns when every range is done.
+    // Loops shorter than minPerThread items per thread use fewer threads.
+    // work is passed by reference to the workers, so nothing is allocated per loop.
+    template <typename Work>
+    void parallelFor(size_t count, size_t minPerThread, const Work& work) {
+        run(count, minPerThread, &callWork<Work>, &work);
+    }
+
+    int getThreadCount() const { return thread_count; }
+
+private:
+    int thread_count;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    typedef void (*RangeFunction)(const void* work, size_t begin, size_t end);
+    RangeFunction current_function;
+    const void* current_work;
+    size_t current_count;
+    int active_ranges;    // Ranges of the current loop, range 0 belongs to the caller
+    int pending_workers;  // Workers still running the current loop
+    unsigned int generation; // Bumped for every loop so workers wake exactly once
+    bool stopping;
+
+    template <typename Work>
+    static void callWork(const void* work, size_t begin, size_t end) {
+        (*static_cast<const Work*>(work))(begin, end);
+    }
+
+    void run(size_t count, size_t minPerThread, RangeFunction function, const void* work);
+    void workerLoop(int workerIndex);
+    static void getRange(size_t count, int ranges, int range, size_t& begin, size_t& end);
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "VerletList.h"
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+
+VerletList::VerletList(float worldWidth, float worldHeight, float skin)
+    : skin(skin),
+    grid(worldWidth, worldHeight, BROADPHASE_CELL_SIZE + 2.0f * BROADPHASE_MARGIN + skin),
+    needs_rebuild(true) {
+}
+
+// Maps the cached lists onto the current bubble list.
+// Bubbles removed since the rebuild are dropped from the lists. Removal moves other bubbles to
+// new indices, so every surviving pair is renumbered and the lists are re-sorted.
+// Returns false if a bubble was added, which needs a rebuild.
+bool VerletList::matchBuild(const BubbleStore& bubbles) {
+    if (bubbles.size() == build_handles.size()) {
+        bool same = true;
+        for (size_t i = 0; i < bubbles.size() && same; ++i) {
+            same = bubbles.getHandle(i) == build_handles[i];
+        }
+        if (same) return true;
+    }
+    if (bubbles.size() > build_handles.size()) return false;
+
+    // Old index -> new index, -1 if removed
+    remap.assign(build_handles.size(), -1);
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        const BubbleHandle handle = bubbles.getHandle(i);
+        const int old = handle.slot < build_index_of_slot.size() ? build_index_of_slot[handle.slot] : -1;
+        if (old < 0 || build_handles[old] != handle) return false;
+        remap[old] = static_cast<int>(i);
+    }
+
+    // Surviving pairs under their new indices, counted then filled per lower index
+    const size_t bubble_count = bubbles.size();
+    remapped_start.assign(bubble_count + 1, 0);
+    for (size_t old = 0; old < build_handles.size(); ++old) {
+        if (remap[old] < 0) continue;
+        for (int e = list_start[old]; e < list_start[old + 1]; ++e) {
+            if (remap[neighbours[e]] < 0) continue;
+            remapped_start[std::min(remap[old], remap[neighbours[e]]) + 1]++;
+        }
+    }
+    for (size_t i = 0; i < bubble_count; ++i) {
+        remapped_start[i + 1] += remapped_start[i];
+    }
+    remapped_neighbours.resize(remapped_start[bubble_count]);
+    list_start.swap(remapped_start);
+    for (size_t old = 0; old < build_handles.size(); ++old) {
+        if (remap[old] < 0) continue;
+        for (int e = remapped_start[old]; e < remapped_start[old + 1]; ++e) {
+            const int other = remap[neighbours[e]];
+            if (other < 0) continue;
+            const int low = std::min(remap[old], other);
+            remapped_neighbours[list_start[low]++] = std::max(remap[old], other);
+        }
+    }
+    // Filling advanced every start to the next list's start
+    for (size_t i = bubble_count; i > 0; --i) {
+        list_start[i] = list_start[i - 1];
+    }
+    list_start[0] = 0;
+    neighbours.swap(remapped_neighbours);
+    for (size_t i = 0; i < bubble_count; ++i) {
+        std::sort(neighbours.begin() + list_start[i], neighbours.begin() + list_start[i + 1]);
+    }
+
+    remapped_positions.resize(bubble_count);
+    remapped_radii.resize(bubble_count);
+    for (size_t old = 0; old < build_handles.size(); ++old) {
+        if (remap[old] < 0) continue;
+        remapped_positions[remap[old]] = build_positions[old];
+        remapped_radii[remap[old]] = build_radii[old];
+    }
+    build_positions.swap(remapped_positions);
+    build_radii.swap(remapped_radii);
+    storeBuildHandles(bubbles);
+    return true;
+}
+
+void VerletList::storeBuildHandles(const BubbleStore& bubbles) {
+    for (BubbleHandle handle : build_handles) {
+        build_index_of_slot[handle.slot] = -1;
+    }
+    build_handles.resize(bubbles.size());
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        const BubbleHandle handle = bubbles.getHandle(i);
+        if (handle.slot >= build_index_of_slot.size()) build_index_of_slot.resize(handle.slot + 1, -1);
+        build_handles[i] = handle;
+        build_index_of_slot[handle.slot] = static_cast<int>(i);
+    }
+}
+
+// True once some bubble moved plus grew by more than half the skin, at which point
+// a pair outside the lists could have come into contact.
+bool VerletList::exceedsSkin(const BubbleStore& bubbles) const {
+    const float half_skin = 0.5f * skin;
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        if (bubbles[i].marked_for_removal) continue;
+        const float growth = glm::max(0.0f, bubbles[i].radius - build_radii[i]);
+        if (growth >= half_skin) return true;
+        const float allowed = half_skin - growth;
+        if (glm::length2(bubbles[i].position - build_positions[i]) > allowed * allowed) return true;
+    }
+    return false;
+}
+
+void VerletList::rebuild(const BubbleStore& bubbles) {
+    grid.findPairs(bubbles, grid_pairs);
+
+    const size_t bubble_count = bubbles.size();
+    list_start.assign(bubble_count + 1, 0);
+    neighbours.clear();
+
+    // Grid pairs come sorted by (a, b), so keeping the ones within reach gives the lists directly
+    const float reach = BROADPHASE_MARGIN + 0.5f * skin;
+    for (const BubblePair& pair : grid_pairs) {
+        ConstBubbleRef b1 = bubbles[pair.a];
+        ConstBubbleRef b2 = bubbles[pair.b];
+        const float extent = b1.radius + b2.radius + 2.0f * reach;
+        glm::vec2 delta_pos = b2.position - b1.position;
+        if (glm::abs(delta_pos.x) < extent && glm::abs(delta_pos.y) < extent) {
+            neighbours.push_back(pair.b);
+            list_start[pair.a + 1]++;
+        }
+    }
+    for (size_t i = 0; i < bubble_count; ++i) {
+        list_start[i + 1] += list_start[i];
+    }
+
+    storeBuildHandles(bubbles);
+    build_positions.resize(bubble_count);
+    build_radii.resize(bubble_count);
+    for (size_t i = 0; i < bubble_count; ++i) {
+        build_positions[i] = bubbles[i].position;
+        build_radii[i] = bubbles[i].radius;
+    }
+
+    needs_rebuild = false;
+    stats.rebuilds++;
+    stats.max_list_size = 0;
+    for (size_t i = 0; i < bubble_count; ++i) {
+        stats.max_list_size = std::max(stats.max_list_size, list_start[i + 1] - list_start[i]);
+    }
+    stats.average_list_size = bubble_count > 0 ? static_cast<float>(neighbours.size()) / bubble_count : 0.0f;
+}
+
+void VerletList::findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) {
+    stats.steps++;
+    if (needs_rebuild || !matchBuild(bubbles) || exceedsSkin(bubbles)) {
+        rebuild(bubbles);
+    }
+
+    // Walk the cached lists, they are already in (a, b) order
+    pairs.clear();
+    for (size_t i = 0; i < bubbles.size(); ++i) {
+        if (bubbles[i].marked_for_removal) continue;
+        for (int e = list_start[i]; e < list_start[i + 1]; ++e) {
+            pairs.push_back({ static_cast<int>(i), neighbours[e] });
+        }
+    }
+    stats.last_pair_count = pairs.size();
+}
@@ -0,0 +1,64 @@
+#ifndef VERLET_LIST_H
+#define VERLET_LIST_H
+
+#include <vector>
+#include "BubbleStore.h"
+#include "Broadphase.h"
+#include "SpatialHash.h"
+
+// Rebuild and list size statistics, used to tune VERLET_SKIN for a scene density.
+struct VerletListStats {
+    size_t steps = 0;          // findPairs calls
+    size_t rebuilds = 0;       // Calls that had to rebuild the lists
+    size_t last_pair_count = 0;
+    float average_list_size = 0.0f; // Mean neighbours per bubble at the last rebuild
+    int max_list_size = 0;          // Largest neighbour list at the last rebuild
+
+    float getRebuildRate() const { return steps > 0 ? static_cast<float>(rebuilds) / steps : 0.0f; }
+};
+
+// Verlet neighbour lists: candidate pairs are gathered with bounds grown by a skin and cached.
+// The cached lists stay valid until some bubble has moved plus grown by more than half the skin
+// since the last rebuild, so most steps only walk the lists without any spatial queries.
+class VerletList : public Broadphase {
+public:
+    VerletList(float worldWidth, float worldHeight, float skin);
+
+    void findPairs(const BubbleStore& bubbles, std::vector<BubblePair>& pairs) override;
+    void invalidate() override { needs_rebuild = true; }
+
+    const VerletListStats& getStats() const { return stats; }
+    void resetStats() { stats = VerletListStats(); }
+
+private:
+    float skin;
+    SpatialHash grid;          // Used only for rebuilds, cells cover the skin as well
+    bool needs_rebuild;
+
+    // Lists in compressed form: neighbours of bubble i (all > i) are
+    // neighbours[list_start[i] .. list_start[i + 1])
+    std::vector<int> list_start;
+    std::vector<int> neighbours;
+    std::vector<BubblePair> grid_pairs; // Scratch for rebuilds
+    // Scratch for matchBuild
+    std::vector<int> remap;
+    std::vector<int> remapped_start;
+    std::vector<int> remapped_neighbours;
+    std::vector<glm::vec2> remapped_positions;
+    std::vector<float> remapped_radii;
+
+    // Bubble state at the last rebuild
+    std::vector<BubbleHandle> build_handles;
+    std::vector<int> build_index_of_slot; // BubbleHandle::slot -> index at the last rebuild, -1 if none
+    std::vector<glm::vec2> build_positions;
+    std::vector<float> build_radii;
+
+    VerletListStats stats;
+
+    bool matchBuild(const BubbleStore& bubbles);
+    void storeBuildHandles(const BubbleStore& bubbles);
+    bool exceedsSkin(const BubbleStore& bubbles) const;
+    void rebuild(const BubbleStore& bubbles);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "XpbdContactSolver.h"
+#include "SimulationConstants.h"
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+
+XpbdContactSolver::XpbdContactSolver()
+    : iterations(XPBD_ITERATIONS),
+    contact_compliance(XPBD_CONTACT_COMPLIANCE),
+    last_overlap(0.0f) {
+}
+
+void XpbdContactSolver::predict(BubbleStore& bubbles, float dt) {
+    const size_t bubble_count = bubbles.size();
+    glm::vec2* positions = bubbles.getPositions();
+    glm::vec2* velocities = bubbles.getVelocities();
+    const glm::vec2* forces = bubbles.getForces();
+    const float* masses = bubbles.getMasses();
+    const uint8_t* sleeping = bubbles.getSleepingFlags();
+    const uint8_t* removed = bubbles.getRemovalFlags();
+
+    start_positions.assign(positions, positions + bubble_count);
+    for (size_t i = 0; i < bubble_count; ++i) {
+        if (sleeping[i] || removed[i]) continue;
+        velocities[i] += forces[i] / masses[i] * dt;
+        positions[i] += velocities[i] * dt;
+    }
+}
+
+void XpbdContactSolver::addPair(int a, int b) {
+    pairs.push_back({ a, b, 0.0f, 0.0f });
+}
+
+void XpbdContactSolver::addSurface(int bubble, glm::vec2 point, glm::vec2 normal, float staticLoad,
+    float staticFriction, float dynamicFriction) {
+    surface_contacts.push_back({ bubble, point, normal, staticLoad, staticFriction, dynamicFriction, 0.0f, 0.0f });
+}
+
+void XpbdContactSolver::measureStartOverlaps(const float* radii) {
+    for (PairConstraint& pair : pairs) {
+        const float dist = glm::length(start_positions[pair.b] - start_positions[pair.a]);
+        pair.start_overlap = glm::max(0.0f, radii[pair.a] + radii[pair.b] - dist);
+    }
+    for (SurfaceConstraint& contact : surface_contacts) {
+        const float clearance = glm::dot(contact.normal, start_positions[contact.bubble] - contact.point) - radii[contact.bubble];
+        contact.start_depth = glm::max(0.0f, -clearance);
+    }
+}
+
+// Gauss-Seidel over the pairs in the order they were added, so a run is repeatable
+void XpbdContactSolver::projectPairs(glm::vec2* positions, const float* radii, float compliance_term, bool keepStartOverlap) {
+    for (PairConstraint& pair : pairs) {
+        const float w_a = inverse_masses[pair.a];
+        const float w_b = inverse_masses[pair.b];
+        const float w_sum = w_a + w_b + compliance_term;
+        if (w_sum <= 0.0f) continue;
+
+        const glm::vec2 delta = positions[pair.b] - positions[pair.a];
+        const float dist_sq = glm::length2(delta);
+        const float sum_radii = radii[pair.a] + radii[pair.b] - (keepStartOverlap ? pair.start_overlap : 0.0f);
+        if (dist_sq >= sum_radii * sum_radii || dist_sq < 0.0001f) continue; // Inequality, separated pairs are left alone
+
+        const float dist = glm::sqrt(dist_sq);
+        const glm::vec2 normal = delta / dist;
+        const float constraint = dist - sum_radii;
+        const float delta_lambda = (-constraint - compliance_term * pair.lambda) / w_sum;
+        pair.lambda += delta_lambda;
+        positions[pair.a] -= w_a * delta_lambda * normal;
+        positions[pair.b] += w_b * delta_lambda * normal;
+    }
+}
+
+// Surfaces are rigid, so each projection puts the bubble exactly on the surface
+void XpbdContactSolver::projectSurfaces(glm::vec2* positions, const float* radii, bool keepStartOverlap) {
+    for (SurfaceConstraint& contact : surface_contacts) {
+        const float w = inverse_masses[contact.bubble];
+        if (w <= 0.0f) continue;
+
+        glm::vec2& position = positions[contact.bubble];
+        const float allowed = keepStartOverlap ? contact.start_depth : 0.0f;
+        const float constraint = glm::dot(contact.normal, position - contact.point) - radii[contact.bubble] + allowed;
+        if (constraint >= 0.0f) continue;
+
+        contact.lambda -= constraint / w;
+        position -= constraint * contact.normal;
+    }
+}
+
+// Coulomb friction on the tangential motion of the step. The normal force is lambda / dt^2 plus the
+// static load, and a force f moves the bubble by f * w * dt^2, so the bounds are displacements.
+void XpbdContactSolver::applyFriction(glm::vec2* positions, float dt) {
+    for (const SurfaceConstraint& contact : surface_contacts) {
+        const float w = inverse_masses[contact.bubble];
+        if (w <= 0.0f) continue;
+
+        glm::vec2& position = positions[contact.bubble];
+        const glm::vec2 motion = position - start_positions[contact.bubble];
+        const glm::vec2 tangential = motion - glm::dot(motion, contact.normal) * contact.normal;
+        const float slide = glm::length(tangential);
+        if (slide <= 0.0f) continue;
+
+        const float load = contact.lambda * w + contact.static_load * w * dt * dt;
+        if (slide < contact.static_friction * load) {
+            position -= tangential; // Static adhesion holds
+        }
+        else {
+            position -= tangential * (glm::min(contact.dynamic_friction * load, slide) / slide);
+        }
+    }
+}
+
+void XpbdContactSolver::solve(BubbleStore& bubbles, float dt) {
+    const size_t bubble_count = bubbles.size();
+    glm::vec2* positions = bubbles.getPositions();
+    glm::vec2* velocities = bubbles.getVelocities();
+    const float* radii = bubbles.getRadii();
+    const float* masses = bubbles.getMasses();
+    const uint8_t* sleeping = bubbles.getSleepingFlags();
+    const uint8_t* removed = bubbles.getRemovalFlags();
+
+    inverse_masses.resize(bubble_count);
+    for (size_t i = 0; i < bubble_count; ++i) {
+        inverse_masses[i] = sleeping[i] || removed[i] ? 0.0f : 1.0f / masses[i];
+    }
+
+    // Pairs with a removed bubble (fused this step) drop out
+    pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [removed](const PairConstraint& pair) {
+        return removed[pair.a] || removed[pair.b];
+    }), pairs.end());
+
+    measureStartOverlaps(radii);
+    const float compliance_term = contact_compliance / (dt * dt);
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        projectPairs(positions, radii, compliance_term, true);
+        projectSurfaces(positions, radii, true);
+    }
+    applyFriction(positions, dt);
+
+    for (size_t i = 0; i < bubble_count; ++i) {
+        if (inverse_masses[i] <= 0.0f) continue;
+        velocities[i] = (positions[i] - start_positions[i]) / dt;
+    }
+
+    // Rigid, and after the velocities, so the old overlap goes without a push
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        projectPairs(positions, radii, 0.0f, false);
+        projectSurfaces(positions, radii, false);
+    }
+
+    last_overlap = 0.0f;
+    for (const PairConstraint& pair : pairs) {
+        const float overlap = radii[pair.a] + radii[pair.b] - glm::length(positions[pair.b] - positions[pair.a]);
+        last_overlap = glm::max(last_overlap, overlap);
+    }
+    pairs.clear();
+    surface_contacts.clear();
+}
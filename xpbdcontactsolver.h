@@ -0,0 +1,83 @@
+#ifndef XPBD_CONTACT_SOLVER_H
+#define XPBD_CONTACT_SOLVER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BubbleStore.h"
+
+// Extended position based dynamics (Macklin et al. 2016) for bubble contacts.
+// A step first moves every free bubble to where its body forces take it, then projects the
+// constraints on those predicted positions a fixed number of times:
+//     bubble-bubble  C = |x_b - x_a| - (r_a + r_b) >= 0, compliance alpha
+//     surface        C = n . (x - p) - r >= 0, rigid
+// Each projection is dlambda = (-C - alpha / dt^2 * lambda) / (sum of w + alpha / dt^2) with w = 1 / m,
+// so a stiff contact never overshoots and a soft one gives way the same whatever dt is.
+// Adhesion is Coulomb friction on the surface contacts, bounded by the coefficients times the normal
+// load, applied once after the projections. Velocities are the position change over dt.
+// Overlap a contact already had at the start of the step (growth, fusion, a soft contact) is allowed
+// during those projections and pushed out afterwards by moving positions only, so it never turns
+// into separation speed.
+// Sleeping and removed bubbles have w = 0 and never move.
+class XpbdContactSolver {
+public:
+    XpbdContactSolver();
+
+    // Remembers every position and moves free bubbles to x + dt * v, with v already advanced by F / m * dt
+    void predict(BubbleStore& bubbles, float dt);
+    glm::vec2 getStartPosition(int index) const { return start_positions[index]; }
+
+    // Constraints of the step, cleared by solve
+    void addPair(int a, int b);
+    // point lies on the surface and normal points to the fluid. staticLoad is the normal force the
+    // bubble puts on the surface at rest, added to the contact force for the friction bound.
+    void addSurface(int bubble, glm::vec2 point, glm::vec2 normal, float staticLoad, float staticFriction, float dynamicFriction);
+    size_t getPairCount() const { return pairs.size(); }
+    size_t getSurfaceCount() const { return surface_contacts.size(); }
+
+    // Projects the constraints, sets velocities from the position change since predict, then
+    // pushes out the overlap left from the start of the step
+    void solve(BubbleStore& bubbles, float dt);
+
+    void setIterations(int count) { iterations = count > 0 ? count : 1; }
+    int getIterations() const { return iterations; }
+    // Inverse stiffness of bubble-bubble contacts, 0 for rigid
+    void setContactCompliance(float compliance) { contact_compliance = glm::max(0.0f, compliance); }
+    float getContactCompliance() const { return contact_compliance; }
+    // Deepest bubble-bubble overlap left after the last solve, in pixels
+    float getLastOverlap() const { return last_overlap; }
+
+private:
+    struct PairConstraint {
+        int a;
+        int b;
+        float lambda;
+        float start_overlap; // At the start positions, 0 if the pair was apart
+    };
+    struct SurfaceConstraint {
+        int bubble;
+        glm::vec2 point;
+        glm::vec2 normal;
+        float static_load;
+        float static_friction;
+        float dynamic_friction;
+        float lambda;
+        float start_depth; // Penetration at the start position, 0 if it was clear
+    };
+    std::vector<PairConstraint> pairs;
+    std::vector<SurfaceConstraint> surface_contacts;
+
+    int iterations;
+    float contact_compliance;
+    float last_overlap;
+
+    std::vector<glm::vec2> start_positions; // Per bubble, positions at predict
+    std::vector<float> inverse_masses;      // Per bubble, 0 for fixed bubbles
+
+    // With keepStartOverlap each constraint only stops its contact getting deeper than at the start
+    void projectPairs(glm::vec2* positions, const float* radii, float compliance_term, bool keepStartOverlap);
+    void projectSurfaces(glm::vec2* positions, const float* radii, bool keepStartOverlap);
+    void measureStartOverlaps(const float* radii);
+    void applyFriction(glm::vec2* positions, float dt);
+};
+
+#endif